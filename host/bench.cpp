@@ -0,0 +1,167 @@
+/*!
+ * @file bench.cpp
+ *
+ * Runs the workloads of the examples through the MAX3000 component on the simulator and
+ * reports what driving the boards cost per frame:
+ *
+ *   clock    an hour of the clock example, one update a minute
+ *   scroll   a line of text crossing the display once, with the scroll actions
+ *   gif      examples/animation.gif played once on a single board, converted as the firmware
+ *            build does
+ *
+ * Usage: bench [boards wide] [boards high] [shift clock Hz]
+ *
+ * Times are simulated, see max3000_sim.h.
+ */
+
+#include "max3000.h"
+#include "max3000_sim.h"
+#include "animation_data.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+/**
+ * @brief A font of 3x5 digits and made-up glyphs for everything else, 4 columns per character.
+ */
+class BlockFont : public display::BaseFont {
+  public:
+    void print(int x, int y, display::DisplayBuffer *display, Color color, const char *text, Color background) override {
+        static const uint16_t DIGITS[10] = { 0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF };
+        for(; *text; text++, x += 4) {
+            uint16_t glyph;
+            if((*text >= '0') && (*text <= '9')) {
+                glyph = DIGITS[*text - '0'];
+            } else if(*text == ':') {
+                glyph = 0x0410;
+            } else if(*text == ' ') {
+                glyph = 0;
+            } else {
+                glyph = (uint16_t) (*text * 2654435761u >> 17) | 0x4000;
+            }
+            for(int row = 0; row < 5; row++) {
+                for(int col = 0; col < 3; col++) {
+                    if(glyph & (0x4000 >> (row * 3 + col))) {
+                        display->draw_pixel_at(x + col, y + row, color);
+                    }
+                }
+            }
+        }
+    }
+
+    void measure(const char *str, int *width, int *x_offset, int *baseline, int *height) override {
+        *width = 4 * strlen(str);
+        *x_offset = 0;
+        *baseline = 5;
+        *height = 5;
+    }
+};
+
+/**
+ * @brief Totals over the frames of one workload.
+ */
+struct Workload {
+    const char *name;
+    uint32_t frames = 0;
+    uint64_t busyUs = 0;
+    MAX3000_SimCounters total = MAX3000_SimCounters();
+};
+
+// Calls into the component, counting the boards' work and the simulated time spent inside
+static void measure(MAX3000_Simulator & sim, Workload & workload, const std::function<void(void)> & call) {
+    sim.resetCounters();
+    uint64_t start = MAX3000_Simulator::nowUs();
+    call();
+    const MAX3000_SimCounters & counters = sim.counters();
+    if(counters.shiftPushes == 0) {
+        return;
+    }
+    workload.frames++;
+    workload.busyUs += MAX3000_Simulator::nowUs() - start;
+    workload.total.gpioWrites += counters.gpioWrites;
+    workload.total.shiftPushes += counters.shiftPushes;
+    workload.total.pulses += counters.pulses;
+    workload.total.dotFlips += counters.dotFlips;
+    workload.total.conflicts += counters.conflicts;
+}
+
+static void report(const Workload & workload) {
+    uint32_t frames = workload.frames ? workload.frames : 1;
+    printf("%-8s %7u %12.1f %10.1f %9.1f %9.1f %12.1f\n", workload.name, workload.frames,
+           (double) workload.total.gpioWrites / frames, (double) workload.total.shiftPushes / frames,
+           (double) workload.total.pulses / frames, (double) workload.total.dotFlips / frames,
+           (double) workload.busyUs / frames);
+    if(workload.total.conflicts) {
+        printf("         %u row and column conflicts\n", workload.total.conflicts);
+    }
+}
+
+int main(int argc, char **argv) {
+    int wide = argc > 1 ? atoi(argv[1]) : 1;
+    int high = argc > 2 ? atoi(argv[2]) : 1;
+    uint32_t shiftClock = argc > 3 ? strtoul(argv[3], NULL, 10) : 111111;
+
+    MAX3000_Simulator sim(wide * high);
+    MAX3000 display(wide, high);
+    display.set_mosi_pin(sim.pin(MAX3000_SIM_MOSI));
+    display.set_clk_pin(sim.pin(MAX3000_SIM_SCLK));
+    display.set_latch_pin(sim.pin(MAX3000_SIM_LAT));
+    display.set_reset_pin(sim.pin(MAX3000_SIM_RST));
+    display.set_pulse_pin(sim.pin(MAX3000_SIM_PULSE));
+    display.set_col_pin(sim.pin(MAX3000_SIM_COL));
+    display.set_row_pin(sim.pin(MAX3000_SIM_ROW));
+    display.set_dissolve(false);
+    display.set_shift_clock_rate(shiftClock);
+    display.add_animation("tunnel", ANIMATION_DATA, sizeof(ANIMATION_DATA));
+    display.setup();
+
+    BlockFont font;
+    printf("%dx%d boards, shift clock %uHz\n\n", wide, high, shiftClock);
+    printf("%-8s %7s %12s %10s %9s %9s %12s\n", "workload", "frames", "gpio/frame", "push/frame", "pulse/frm",
+           "flip/frm", "us/frame");
+
+    // The clock example: the time and a frame around the board, redrawn every minute
+    Workload clock = { "clock" };
+    int minute = 0;
+    display.set_writer([&](display::DisplayBuffer & it) {
+        int hour = minute / 60 % 12 + 1;
+        it.printf(4, 6, &font, "%d:%02d", hour, minute % 60);
+        it.line(1, 0, 26, 0);
+        it.line(0, 1, 0, 14);
+        it.line(1, 15, 26, 15);
+        it.line(27, 1, 27, 14);
+    });
+    for(minute = 0; minute < 60; minute++) {
+        measure(sim, clock, [&] { display.update(); });
+        MAX3000_Simulator::advanceUs(60000000ULL);
+    }
+    report(clock);
+
+    // Scrolling text: the loop runs every millisecond until the text has gone
+    Workload scroll = { "scroll" };
+    display.start_scroll("Hello from the flipdots 12:34", &font, 5, 30.0f, false);
+    while(display.is_scrolling()) {
+        measure(sim, scroll, [&] { display.loop(); });
+        MAX3000_Simulator::advanceUs(1000);
+    }
+    report(scroll);
+
+    // The animated GIF example, played through once. It is converted for a single board.
+    if(wide * high != 1) {
+        printf("gif      skipped, converted for a single board\n");
+        return 0;
+    }
+    Workload gif = { "gif" };
+    display.play_animation("tunnel", false);
+    while(display.is_animation_playing()) {
+        measure(sim, gif, [&] { display.loop(); });
+        MAX3000_Simulator::advanceUs(1000);
+    }
+    report(gif);
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*!
+ * @file hal.cpp
+ *
+ * ESPHome HAL, helpers and sockets for the host build. Time comes from the simulator clock.
+ */
+
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/components/socket/socket.h"
+#include "max3000_sim.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <unistd.h>
+
+namespace esphome {
+
+using max3000::MAX3000_Simulator;
+
+namespace setup_priority {
+const float HARDWARE = 800.0f;
+const float PROCESSOR = 400.0f;
+const float AFTER_WIFI = 200.0f;
+}  // namespace setup_priority
+
+bool host_log_enabled() {
+  static const bool enabled = getenv("MAX3000_HOST_LOG") != nullptr;
+  return enabled;
+}
+
+void yield() {}
+uint32_t millis() { return MAX3000_Simulator::nowUs() / 1000; }
+uint32_t micros() { return MAX3000_Simulator::nowUs(); }
+void delay(uint32_t ms) { MAX3000_Simulator::advanceUs(ms * 1000ULL); }
+void delayMicroseconds(uint32_t us) { MAX3000_Simulator::advanceUs(us); }
+
+// Reading the counter takes a few cycles, so loops spinning on it move the clock on
+uint32_t arch_get_cpu_cycle_count() {
+  MAX3000_Simulator::advanceCycles(MAX3000_SIM_CYCLE_READ);
+  return (uint32_t) MAX3000_Simulator::nowCycles();
+}
+uint32_t arch_get_cpu_freq_hz() { return MAX3000_SIM_CPU_HZ; }
+
+uint8_t progmem_read_byte(const uint8_t *addr) { return *addr; }
+uint16_t progmem_read_uint16(const uint16_t *addr) { return *addr; }
+
+// Seeded, so runs repeat exactly
+uint32_t random_uint32() {
+  static std::mt19937 generator(3000);
+  return generator();
+}
+
+namespace socket {
+
+class HostSocket : public Socket {
+ public:
+  explicit HostSocket(int fd) : fd_(fd) {}
+  ~HostSocket() override { close(); }
+
+  int bind(const struct sockaddr *addr, socklen_t addrlen) override { return ::bind(fd_, addr, addrlen); }
+  int getsockname(struct sockaddr *addr, socklen_t *addrlen) override { return ::getsockname(fd_, addr, addrlen); }
+  ssize_t read(void *buf, size_t len) override { return ::read(fd_, buf, len); }
+  int setblocking(bool blocking) override {
+    int flags = fcntl(fd_, F_GETFL, 0);
+    return fcntl(fd_, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+  }
+  int close() override {
+    int ret = fd_ >= 0 ? ::close(fd_) : 0;
+    fd_ = -1;
+    return ret;
+  }
+
+ protected:
+  int fd_;
+};
+
+std::unique_ptr<Socket> socket(int domain, int type, int protocol) {
+  int fd = ::socket(domain, type, protocol);
+  if (fd < 0)
+    return nullptr;
+  return std::unique_ptr<Socket>{new HostSocket(fd)};
+}
+
+std::unique_ptr<Socket> socket_ip(int type, int protocol) { return socket(AF_INET, type, protocol); }
+
+socklen_t set_sockaddr_any(struct sockaddr *addr, socklen_t addrlen, uint16_t port) {
+  if (addrlen < sizeof(struct sockaddr_in)) {
+    errno = EINVAL;
+    return 0;
+  }
+  auto *server = reinterpret_cast<struct sockaddr_in *>(addr);
+  memset(server, 0, sizeof(struct sockaddr_in));
+  server->sin_family = AF_INET;
+  server->sin_addr.s_addr = htonl(INADDR_ANY);
+  server->sin_port = htons(port);
+  return sizeof(struct sockaddr_in);
+}
+
+}  // namespace socket
+}  // namespace esphome
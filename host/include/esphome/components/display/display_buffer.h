@@ -0,0 +1,174 @@
+#pragma once
+
+// Host stand-in for esphome/components/display/display_buffer.h. Only the drawing the component
+// and the benchmarks use is provided, all of it going through draw_pixel_at() like the real one.
+
+#include "esphome/core/component.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+namespace esphome {
+
+struct Color {
+  uint8_t r, g, b, w;
+  Color(uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0, uint8_t white = 0) : r(red), g(green), b(blue), w(white) {}
+  bool is_on() const { return r != 0 || g != 0 || b != 0 || w != 0; }
+};
+
+static const Color COLOR_OFF(0, 0, 0, 0);
+static const Color COLOR_ON(255, 255, 255, 255);
+
+namespace display {
+
+class DisplayBuffer;
+class DisplayPage;
+
+enum class DisplayType {
+  DISPLAY_TYPE_BINARY = 1,
+  DISPLAY_TYPE_GRAYSCALE = 2,
+  DISPLAY_TYPE_COLOR = 3,
+};
+
+enum DisplayRotation {
+  DISPLAY_ROTATION_0_DEGREES = 0,
+  DISPLAY_ROTATION_90_DEGREES = 90,
+  DISPLAY_ROTATION_180_DEGREES = 180,
+  DISPLAY_ROTATION_270_DEGREES = 270,
+};
+
+enum class TextAlign {
+  TOP_LEFT = 0x00,
+};
+
+class BaseFont {
+ public:
+  virtual ~BaseFont() = default;
+  virtual void print(int x, int y, DisplayBuffer *display, Color color, const char *text, Color background) = 0;
+  virtual void measure(const char *str, int *width, int *x_offset, int *baseline, int *height) = 0;
+};
+
+using display_writer_t = std::function<void(DisplayBuffer &)>;
+
+class DisplayBuffer {
+ public:
+  virtual ~DisplayBuffer() = default;
+
+  virtual void fill(Color color) {
+    for (int y = 0; y < get_height(); y++) {
+      for (int x = 0; x < get_width(); x++) {
+        draw_pixel_at(x, y, color);
+      }
+    }
+  }
+  void clear() { fill(COLOR_OFF); }
+
+  int get_width() { return rotation_ % 180 ? get_height_internal() : get_width_internal(); }
+  int get_height() { return rotation_ % 180 ? get_width_internal() : get_height_internal(); }
+
+  void draw_pixel_at(int x, int y, Color color) {
+    switch (rotation_) {
+      case DISPLAY_ROTATION_0_DEGREES:
+        break;
+      case DISPLAY_ROTATION_90_DEGREES:
+        std::swap(x, y);
+        x = get_width_internal() - x - 1;
+        break;
+      case DISPLAY_ROTATION_180_DEGREES:
+        x = get_width_internal() - x - 1;
+        y = get_height_internal() - y - 1;
+        break;
+      case DISPLAY_ROTATION_270_DEGREES:
+        std::swap(x, y);
+        y = get_height_internal() - y - 1;
+        break;
+    }
+    draw_absolute_pixel_internal(x, y, color);
+  }
+
+  void line(int x1, int y1, int x2, int y2, Color color = COLOR_ON) {
+    const int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    const int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+      draw_pixel_at(x1, y1, color);
+      if (x1 == x2 && y1 == y2)
+        break;
+      int e2 = 2 * err;
+      if (e2 >= dy) {
+        err += dy;
+        x1 += sx;
+      }
+      if (e2 <= dx) {
+        err += dx;
+        y1 += sy;
+      }
+    }
+  }
+  void horizontal_line(int x, int y, int width, Color color = COLOR_ON) {
+    for (int i = x; i < x + width; i++)
+      draw_pixel_at(i, y, color);
+  }
+  void vertical_line(int x, int y, int height, Color color = COLOR_ON) {
+    for (int i = y; i < y + height; i++)
+      draw_pixel_at(x, i, color);
+  }
+  void filled_rectangle(int x1, int y1, int width, int height, Color color = COLOR_ON) {
+    for (int i = y1; i < y1 + height; i++)
+      horizontal_line(x1, i, width, color);
+  }
+
+  void print(int x, int y, BaseFont *font, Color color, TextAlign align, const char *text) {
+    font->print(x, y, this, color, text, COLOR_OFF);
+  }
+  void print(int x, int y, BaseFont *font, Color color, const char *text) {
+    print(x, y, font, color, TextAlign::TOP_LEFT, text);
+  }
+  void printf(int x, int y, BaseFont *font, const char *format, ...) __attribute__((format(printf, 5, 6))) {
+    char buffer[256];
+    va_list arg;
+    va_start(arg, format);
+    vsnprintf(buffer, sizeof(buffer), format, arg);
+    va_end(arg);
+    print(x, y, font, COLOR_ON, buffer);
+  }
+  void get_text_bounds(int x, int y, const char *text, BaseFont *font, TextAlign align, int *x1, int *y1, int *width,
+                       int *height) {
+    int x_offset, baseline;
+    font->measure(text, width, &x_offset, &baseline, height);
+    *x1 = x + x_offset;
+    *y1 = y;
+  }
+
+  void set_writer(display_writer_t &&writer) { writer_ = writer; }
+  void set_rotation(DisplayRotation rotation) { rotation_ = rotation; }
+  void set_auto_clear(bool auto_clear_enabled) { auto_clear_enabled_ = auto_clear_enabled; }
+  bool is_clipping() const { return false; }
+
+  virtual DisplayType get_display_type() = 0;
+
+ protected:
+  virtual void draw_absolute_pixel_internal(int x, int y, Color color) = 0;
+  virtual int get_height_internal() = 0;
+  virtual int get_width_internal() = 0;
+
+  void do_update_() {
+    if (auto_clear_enabled_) {
+      clear();
+    }
+    if (writer_) {
+      writer_(*this);
+    }
+  }
+
+  display_writer_t writer_{};
+  DisplayPage *page_{nullptr};
+  DisplayPage *previous_page_{nullptr};
+  DisplayRotation rotation_{DISPLAY_ROTATION_0_DEGREES};
+  bool auto_clear_enabled_{true};
+};
+
+}  // namespace display
+}  // namespace esphome
@@ -0,0 +1,28 @@
+#pragma once
+
+// Host stand-in for esphome/components/socket/socket.h, backed by POSIX sockets
+
+#include <memory>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+namespace esphome {
+namespace socket {
+
+class Socket {
+ public:
+  virtual ~Socket() = default;
+  virtual int bind(const struct sockaddr *addr, socklen_t addrlen) = 0;
+  virtual int getsockname(struct sockaddr *addr, socklen_t *addrlen) = 0;
+  virtual ssize_t read(void *buf, size_t len) = 0;
+  virtual int setblocking(bool blocking) = 0;
+  virtual int close() = 0;
+};
+
+std::unique_ptr<Socket> socket(int domain, int type, int protocol);
+std::unique_ptr<Socket> socket_ip(int type, int protocol);
+socklen_t set_sockaddr_any(struct sockaddr *addr, socklen_t addrlen, uint16_t port);
+
+}  // namespace socket
+}  // namespace esphome
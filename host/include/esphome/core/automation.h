@@ -0,0 +1,40 @@
+#pragma once
+
+// Host stand-in for esphome/core/automation.h, enough for the scroll actions to compile
+
+#include "esphome/core/component.h"
+
+#include <functional>
+
+namespace esphome {
+
+template<typename T, typename... X> class TemplatableValue {
+ public:
+  TemplatableValue() {}
+  TemplatableValue(T value) : value_(value), has_value_(true) {}
+  TemplatableValue(std::function<T(X...)> f) : f_(f), has_value_(true) {}
+  bool has_value() const { return has_value_; }
+  T value(X... x) { return f_ ? f_(x...) : value_; }
+
+ protected:
+  T value_{};
+  std::function<T(X...)> f_;
+  bool has_value_{false};
+};
+
+#define TEMPLATABLE_VALUE_(type, name) \
+ protected: \
+  TemplatableValue<type, Ts...> name##_{}; \
+\
+ public: \
+  template<typename V> void set_##name(V name) { this->name##_ = name; }
+
+#define TEMPLATABLE_VALUE(type, name) TEMPLATABLE_VALUE_(type, name)
+
+template<typename... Ts> class Action {
+ public:
+  virtual ~Action() = default;
+  virtual void play(Ts... x) = 0;
+};
+
+}  // namespace esphome
@@ -0,0 +1,42 @@
+#pragma once
+
+// Host stand-in for esphome/core/component.h
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+
+namespace setup_priority {
+extern const float HARDWARE;
+extern const float PROCESSOR;
+extern const float AFTER_WIFI;
+}  // namespace setup_priority
+
+class Component {
+ public:
+  virtual ~Component() = default;
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return 0.0f; }
+  void mark_failed() { failed_ = true; }
+  bool is_failed() const { return failed_; }
+
+ protected:
+  bool failed_{false};
+};
+
+class PollingComponent : public Component {
+ public:
+  PollingComponent() {}
+  explicit PollingComponent(uint32_t update_interval) : update_interval_(update_interval) {}
+  virtual void update() = 0;
+  void set_update_interval(uint32_t update_interval) { update_interval_ = update_interval; }
+  uint32_t get_update_interval() const { return update_interval_; }
+
+ protected:
+  uint32_t update_interval_{1000};
+};
+
+}  // namespace esphome
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for esphome/core/hal.h. Time is simulated: delays and the cycle counter
+// move the clock in max3000_sim.cpp forward instead of waiting.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define HOT __attribute__((hot))
+
+namespace esphome {
+
+namespace gpio {
+enum Flags : uint8_t {
+  FLAG_NONE = 0x00,
+  FLAG_INPUT = 0x01,
+  FLAG_OUTPUT = 0x02,
+};
+}  // namespace gpio
+
+class GPIOPin {
+ public:
+  virtual ~GPIOPin() = default;
+  virtual void setup() = 0;
+  virtual void pin_mode(gpio::Flags flags) = 0;
+  virtual bool digital_read() = 0;
+  virtual void digital_write(bool value) = 0;
+  virtual std::string dump_summary() const = 0;
+  virtual bool is_internal() { return false; }
+};
+
+class InternalGPIOPin : public GPIOPin {
+ public:
+  virtual uint8_t get_pin() const = 0;
+  virtual bool is_inverted() const = 0;
+  bool is_internal() override { return true; }
+};
+
+void yield();
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+uint32_t arch_get_cpu_cycle_count();
+uint32_t arch_get_cpu_freq_hz();
+
+}  // namespace esphome
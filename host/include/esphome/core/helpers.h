@@ -0,0 +1,40 @@
+#pragma once
+
+// Host stand-in for the parts of esphome/core/helpers.h the component uses
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace esphome {
+
+uint8_t progmem_read_byte(const uint8_t *addr);
+uint16_t progmem_read_uint16(const uint16_t *addr);
+uint32_t random_uint32();
+
+template<typename T> class Parented {
+ public:
+  Parented() {}
+  Parented(T *parent) : parent_(parent) {}
+  T *get_parent() const { return parent_; }
+  void set_parent(T *parent) { parent_ = parent; }
+
+ protected:
+  T *parent_{nullptr};
+};
+
+class HighFrequencyLoopRequester {
+ public:
+  void start() { started_ = true; }
+  void stop() { started_ = false; }
+  bool is_started() const { return started_; }
+
+ protected:
+  bool started_{false};
+};
+
+}  // namespace esphome
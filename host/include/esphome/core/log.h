@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for esphome/core/log.h. Messages go to stderr when MAX3000_HOST_LOG is set
+// in the environment, so test output stays readable.
+
+#include <cstdio>
+
+namespace esphome {
+bool host_log_enabled();
+}  // namespace esphome
+
+#define ESPHOME_LOG_HOST_(letter, tag, ...) \
+  do { \
+    if (esphome::host_log_enabled()) { \
+      fprintf(stderr, "[" letter "][%s] ", tag); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+    } \
+  } while (0)
+
+#define ESP_LOGE(tag, ...) ESPHOME_LOG_HOST_("E", tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESPHOME_LOG_HOST_("W", tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESPHOME_LOG_HOST_("I", tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESPHOME_LOG_HOST_("D", tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESPHOME_LOG_HOST_("V", tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ESPHOME_LOG_HOST_("VV", tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ESPHOME_LOG_HOST_("C", tag, __VA_ARGS__)
+#define LOG_PIN(prefix, pin) ((void) (pin))
+#define YESNO(b) ((b) ? "YES" : "NO")
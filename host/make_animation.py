@@ -0,0 +1,219 @@
+"""Convert a GIF to the dot frames of add_animation(), as a C++ header for the benchmarks.
+
+Usage: make_animation.py GIF OUTPUT WIDTH HEIGHT [RESIZE_W RESIZE_H X Y]
+
+The frames are packed by convert_animation() from src/display.py, so the benchmark plays
+exactly what the firmware would. That needs Pillow; without it a small GIF decoder below
+stands in, whose resizing is close to Pillow's but not identical.
+"""
+
+import ast
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DISPLAY_PY = os.path.join(HERE, "..", "src", "display.py")
+
+# Names from display.py that the conversion needs
+CONVERSION_NAMES = ("pack_frame", "xor_runs", "convert_animation", "PACKET_FULL", "PACKET_XOR_RLE")
+
+
+def load_conversion(image_module):
+    # display.py imports ESPHome, so only the conversion code is taken out of it
+    tree = ast.parse(open(DISPLAY_PY, encoding="utf-8").read())
+    namespace = {
+        "CORE": type("Core", (), {"relative_config_path": staticmethod(lambda path: path)}),
+        "core": type("Core", (), {"EsphomeError": RuntimeError}),
+        "CONF_FILE": "file",
+        "CONF_RESIZE": "resize",
+        "CONF_X": "x",
+        "CONF_Y": "y",
+        "CONF_INVERTED": "inverted",
+    }
+    for node in tree.body:
+        name = getattr(node, "name", None)
+        if isinstance(node, ast.Assign):
+            name = getattr(node.targets[0], "id", None)
+        if name in CONVERSION_NAMES:
+            exec(compile(ast.Module([node], []), DISPLAY_PY, "exec"), namespace)
+    if image_module is not None:
+        sys.modules["PIL"] = image_module
+    return namespace["convert_animation"]
+
+
+class GifFrame:
+    """A composited GIF frame, with the parts of PIL.Image that convert_animation() uses."""
+
+    def __init__(self, width, height, pixels, duration):
+        self.width, self.height, self.pixels = width, height, pixels
+        self.info = {"duration": duration}
+
+    def convert(self, mode):
+        # ITU-R 601-2 luma, as Pillow's "L"
+        pixels = [(r * 299 + g * 587 + b * 114) // 1000 for r, g, b in self.pixels]
+        return GifFrame(self.width, self.height, pixels, self.info["duration"])
+
+    def resize(self, size):
+        # Average of the source pixels each destination pixel covers
+        width, height = size
+        pixels = []
+        for y in range(height):
+            y0, y1 = y * self.height // height, max((y + 1) * self.height // height, y * self.height // height + 1)
+            for x in range(width):
+                x0, x1 = x * self.width // width, max((x + 1) * self.width // width, x * self.width // width + 1)
+                area = [self.pixels[sy * self.width + sx] for sy in range(y0, y1) for sx in range(x0, x1)]
+                pixels.append(sum(area) // len(area))
+        return GifFrame(width, height, pixels, self.info["duration"])
+
+    def load(self):
+        frame = self
+        return type("Access", (), {"__getitem__": lambda _, xy: frame.pixels[xy[1] * frame.width + xy[0]]})()
+
+
+def lzw_decode(data, min_code_size):
+    clear, end = 1 << min_code_size, (1 << min_code_size) + 1
+    table = [[i] for i in range(clear)] + [[], []]
+    size, out, previous = min_code_size + 1, [], None
+    bits = value = 0
+    for byte in data:
+        value |= byte << bits
+        bits += 8
+        while bits >= size:
+            code = value & ((1 << size) - 1)
+            value >>= size
+            bits -= size
+            if code == clear:
+                table = table[: end + 1]
+                size, previous = min_code_size + 1, None
+                continue
+            if code == end:
+                return out
+            if previous is None:
+                entry = table[code]
+            elif code < len(table):
+                entry = table[code]
+                table.append(previous + entry[:1])
+            else:
+                entry = previous + previous[:1]
+                table.append(entry)
+            out.extend(entry)
+            previous = entry
+            if len(table) == 1 << size and size < 12:
+                size += 1
+    return out
+
+
+def decode_gif(path):
+    data = open(path, "rb").read()
+    if data[:3] != b"GIF":
+        raise RuntimeError(f"{path} is not a GIF")
+    width, height, flags, background = data[6] | data[7] << 8, data[8] | data[9] << 8, data[10], data[11]
+    pos = 13
+    global_table = []
+    if flags & 0x80:
+        count = 2 << (flags & 7)
+        global_table = [tuple(data[pos + i * 3 : pos + i * 3 + 3]) for i in range(count)]
+        pos += count * 3
+    background_color = global_table[background] if background < len(global_table) else (0, 0, 0)
+
+    canvas = [background_color] * (width * height)
+    frames = []
+    delay, disposal, transparent = 100, 0, None
+    while pos < len(data):
+        block = data[pos]
+        pos += 1
+        if block == 0x3B:
+            break
+        if block == 0x21:
+            label = data[pos]
+            pos += 1
+            while data[pos]:
+                if label == 0xF9:
+                    packed = data[pos + 1]
+                    disposal = (packed >> 2) & 7
+                    delay = (data[pos + 2] | data[pos + 3] << 8) * 10
+                    transparent = data[pos + 4] if packed & 1 else None
+                pos += data[pos] + 1
+            pos += 1
+            continue
+        left, top = data[pos] | data[pos + 1] << 8, data[pos + 2] | data[pos + 3] << 8
+        w, h, packed = data[pos + 4] | data[pos + 5] << 8, data[pos + 6] | data[pos + 7] << 8, data[pos + 8]
+        pos += 9
+        table = global_table
+        if packed & 0x80:
+            count = 2 << (packed & 7)
+            table = [tuple(data[pos + i * 3 : pos + i * 3 + 3]) for i in range(count)]
+            pos += count * 3
+        min_code_size = data[pos]
+        pos += 1
+        chunks = bytearray()
+        while data[pos]:
+            chunks += data[pos + 1 : pos + 1 + data[pos]]
+            pos += data[pos] + 1
+        pos += 1
+        indexes = lzw_decode(chunks, min_code_size)
+
+        rows = list(range(h))
+        if packed & 0x40:
+            rows = list(range(0, h, 8)) + list(range(4, h, 8)) + list(range(2, h, 4)) + list(range(1, h, 2))
+        before = list(canvas)
+        for i, row in enumerate(rows):
+            for x in range(w):
+                index = indexes[i * w + x] if i * w + x < len(indexes) else 0
+                if index != transparent and 0 <= left + x < width and 0 <= top + row < height:
+                    canvas[(top + row) * width + left + x] = table[index] if index < len(table) else (0, 0, 0)
+        frames.append(GifFrame(width, height, list(canvas), delay))
+
+        if disposal == 2:
+            for row in range(top, min(top + h, height)):
+                for x in range(left, min(left + w, width)):
+                    canvas[row * width + x] = background_color
+        elif disposal == 3:
+            canvas = before
+        delay, disposal, transparent = 100, 0, None
+    return frames
+
+
+def fallback_pil():
+    # Just enough of PIL for convert_animation()
+    frames = {}
+
+    class Image:
+        @staticmethod
+        def open(path):
+            frames[path] = decode_gif(path)
+            return path
+
+    class ImageSequence:
+        @staticmethod
+        def Iterator(path):
+            return iter(frames[path])
+
+    return type("PIL", (), {"Image": Image, "ImageSequence": ImageSequence})
+
+
+def main():
+    gif, output, width, height = sys.argv[1], sys.argv[2], int(sys.argv[3]), int(sys.argv[4])
+    animation = {"file": gif, "x": 0, "y": 0, "inverted": False}
+    if len(sys.argv) > 5:
+        animation["resize"] = (int(sys.argv[5]), int(sys.argv[6]))
+        animation["x"], animation["y"] = int(sys.argv[7]), int(sys.argv[8])
+
+    try:
+        import PIL.Image  # noqa: F401
+
+        convert_animation = load_conversion(None)
+    except ImportError:
+        convert_animation = load_conversion(fallback_pil())
+    data = convert_animation(animation, width, height)
+
+    with open(output, "w", encoding="utf-8") as out:
+        out.write(f"// Generated by make_animation.py from {os.path.basename(gif)}\n")
+        out.write("static const uint8_t ANIMATION_DATA[] = {\n")
+        for i in range(0, len(data), 16):
+            out.write("    " + ", ".join(f"0x{b:02X}" for b in data[i : i + 16]) + ",\n")
+        out.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,197 @@
+/*!
+ * @file max3000_sim.cpp
+ *
+ * Host simulator for the MAX3000 driver boards, see max3000_sim.h.
+ */
+
+#include "max3000_sim.h"
+
+namespace esphome {
+namespace max3000 {
+
+// Shift register bits of each board, as wired on the driver
+#define SIM_COL_A2 0
+#define SIM_COL_A1 1
+#define SIM_COL_A0 2
+#define SIM_ROW_A0 3
+#define SIM_ROW_A1 4
+#define SIM_ROW_A2 5
+#define SIM_ROW_BANK 6
+#define SIM_COL_BANK0 7
+#define SIM_COL_SOURCE 8
+#define SIM_ROW_SOURCE 10
+#define SIM_COL_BANK1 11
+
+#define SIM_BIT(_reg, _bit) (((_reg) >> (_bit)) & 1)
+
+// Decoder outputs of the panel, by column and row. Rows are numbered from the bottom.
+static const uint8_t colCodes[PANEL_WIDTH] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
+    15, 14, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
+static const uint8_t rowCodes[PANEL_HEIGHT] = { 14, 1, 15, 0, 12, 3, 13, 2, 10, 5, 11, 4, 8, 7, 9, 6 };
+
+uint64_t MAX3000_Simulator::cycles = 0;
+
+void MAX3000_SimPin::digital_write(bool value) {
+    bool previous = level;
+    level = value;
+    sim->pinWritten(this, previous);
+}
+
+void MAX3000_SimSPI::transfer(const uint8_t *data, size_t length) {
+    MAX3000_Simulator::Chain & chain = sim->chains[0];
+    for(size_t i = 0; i < length; i++) {
+        for(int bit = 7; bit >= 0; bit--) {
+            chain.bits.push_back((data[i] >> bit) & 1);
+        }
+    }
+}
+
+MAX3000_Simulator::MAX3000_Simulator(size_t numBoards) : spiPort(this) {
+    for(int line = 0; line < MAX3000_SIM_LINES; line++) {
+        pins[line] = new MAX3000_SimPin(this, allPins.size());
+        allPins.push_back(pins[line]);
+    }
+
+    Chain main;
+    for(int line = 0; line < MAX3000_SIM_LINES; line++) {
+        main.lines[line] = pins[line];
+    }
+    main.firstBoard = 0;
+    main.numBoards  = numBoards;
+    main.active     = false;
+    chains.push_back(main);
+
+    registers.assign(numBoards, 0);
+    dots.assign(numBoards, std::vector<uint8_t>(PANEL_WIDTH * PANEL_HEIGHT, 0));
+}
+
+MAX3000_Simulator::~MAX3000_Simulator(void) {
+    for(MAX3000_SimPin *pin : allPins) {
+        delete pin;
+    }
+}
+
+MAX3000_Config MAX3000_Simulator::config(uint16_t width, uint16_t height, bool spi) {
+    if(spi) {
+        return MAX3000_Config(width, height, &spiPort, pins[MAX3000_SIM_LAT], pins[MAX3000_SIM_RST],
+                              pins[MAX3000_SIM_PULSE], pins[MAX3000_SIM_COL], pins[MAX3000_SIM_ROW]);
+    }
+    return MAX3000_Config(width, height, pins[MAX3000_SIM_MOSI], pins[MAX3000_SIM_SCLK], pins[MAX3000_SIM_LAT],
+                          pins[MAX3000_SIM_RST], pins[MAX3000_SIM_PULSE], pins[MAX3000_SIM_COL], pins[MAX3000_SIM_ROW]);
+}
+
+MAX3000_Chain MAX3000_Simulator::addChain(size_t numBoards, uint8_t ownLines) {
+    chains[0].numBoards -= numBoards;
+
+    Chain chain = Chain();
+    MAX3000_Chain result = { numBoards, NULL, NULL, NULL, NULL, NULL, NULL };
+    GPIOPin **resultLines[MAX3000_SIM_LINES] = { &result.mosi_pin, &result.sclk_pin, &result.lat_pin, NULL,
+                                                 &result.pulse_pin, &result.col_pin, &result.row_pin };
+    for(int line = 0; line < MAX3000_SIM_LINES; line++) {
+        if((line == MAX3000_SIM_MOSI) || ((line != MAX3000_SIM_RST) && (ownLines & (1 << line)))) {
+            chain.lines[line] = new MAX3000_SimPin(this, allPins.size());
+            allPins.push_back(chain.lines[line]);
+            *resultLines[line] = chain.lines[line];
+        } else {
+            chain.lines[line] = pins[line];
+        }
+    }
+    chain.numBoards = numBoards;
+    chain.active    = false;
+    chains.push_back(chain);
+
+    // Extra chains take the boards after those still on the main chain, in the order added
+    size_t board = 0;
+    for(Chain & each : chains) {
+        each.firstBoard = board;
+        board += each.numBoards;
+    }
+    return result;
+}
+
+void MAX3000_Simulator::pinWritten(MAX3000_SimPin *pin, bool previous) {
+    count.gpioWrites++;
+    bool rising = pin->level && !previous;
+
+    bool latched = false;
+    for(Chain & chain : chains) {
+        if(rising && (pin == chain.lines[MAX3000_SIM_SCLK])) {
+            chain.bits.push_back(chain.lines[MAX3000_SIM_MOSI]->level);
+        }
+        if(rising && (pin == chain.lines[MAX3000_SIM_LAT])) {
+            latch(chain);
+            latched = true;
+            // The drivers follow the latch, so a new dot is flipped if the pulse is still on
+            if(chain.active) {
+                pulse(chain);
+            }
+        }
+
+        // Flip when the chain's pulse line and both enables become active
+        bool active = chain.lines[MAX3000_SIM_PULSE]->level && !chain.lines[MAX3000_SIM_ROW]->level &&
+                      !chain.lines[MAX3000_SIM_COL]->level;
+        if(active && !chain.active) {
+            pulse(chain);
+        }
+        chain.active = active;
+    }
+    if(latched) {
+        count.shiftPushes++;
+    }
+}
+
+void MAX3000_Simulator::latch(Chain & chain) {
+    // The bit clocked in first has travelled furthest, to the top of the chain's first board.
+    // Bits clocked in before that have already fallen off the end.
+    size_t chainBits = chain.numBoards * 16;
+    size_t length = chain.bits.size();
+    for(size_t board = 0; board < chain.numBoards; board++) {
+        uint16_t reg = registers[chain.firstBoard + board];
+        for(size_t bit = 0; bit < 16; bit++) {
+            // Bits not clocked in since the last latch still hold what shifted through before
+            size_t fromEnd = chainBits - (board * 16 + bit);
+            if(fromEnd <= length) {
+                uint16_t mask = 1 << (15 - bit);
+                reg = chain.bits[length - fromEnd] ? (reg | mask) : (reg & ~mask);
+            }
+        }
+        registers[chain.firstBoard + board] = reg;
+    }
+    chain.bits.clear();
+}
+
+void MAX3000_Simulator::pulse(Chain & chain) {
+    count.pulses++;
+    for(size_t board = chain.firstBoard; board < chain.firstBoard + chain.numBoards; board++) {
+        uint16_t reg = registers[board];
+        bool colSource = SIM_BIT(reg, SIM_COL_SOURCE);
+        bool rowSource = SIM_BIT(reg, SIM_ROW_SOURCE);
+        if(!colSource && !rowSource) {
+            continue;
+        }
+        if(colSource && rowSource) {
+            count.conflicts++;
+            continue;
+        }
+
+        uint8_t colCode = (SIM_BIT(reg, SIM_COL_BANK1) << 4) | (SIM_BIT(reg, SIM_COL_BANK0) << 3) |
+                          (SIM_BIT(reg, SIM_COL_A2) << 2) | (SIM_BIT(reg, SIM_COL_A1) << 1) | SIM_BIT(reg, SIM_COL_A0);
+        uint8_t rowCode = (SIM_BIT(reg, SIM_ROW_BANK) << 3) | (SIM_BIT(reg, SIM_ROW_A2) << 2) |
+                          (SIM_BIT(reg, SIM_ROW_A1) << 1) | SIM_BIT(reg, SIM_ROW_A0);
+        for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+            if(colCodes[col] != colCode) {
+                continue;
+            }
+            for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+                if(rowCodes[row] == rowCode) {
+                    // Sourcing the row sets the dot, sourcing the column clears it
+                    dots[board][col * PANEL_HEIGHT + (PANEL_HEIGHT - 1 - row)] = rowSource;
+                    count.dotFlips++;
+                }
+            }
+        }
+    }
+}
+
+}  // namespace max3000
+}  // namespace esphome
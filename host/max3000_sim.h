@@ -0,0 +1,177 @@
+#include "esphome/core/hal.h"
+#include "MAX3000_Lib.h"
+
+#include <vector>
+
+/*!
+ * @file max3000_sim.h
+ *
+ * Host simulator for the MAX3000 driver boards.
+ *
+ * The simulator hands out fake GPIO pins and decodes what the library writes to them the way
+ * the driver boards do: bits clocked in on MOSI/CLK are latched into each board's shift
+ * register on LAT, and while PULSE is high with ROW and COL enabled, every board whose
+ * register selects a dot flips it. The result is a per-dot picture of the wall that tests
+ * compare against the frame buffer, and counters that benchmarks report.
+ *
+ * Time is simulated too. Every delay and every read of the cycle counter moves the clock
+ * forward, so frame times are those of a 240MHz CPU whose GPIO writes cost nothing.
+ */
+
+namespace esphome {
+namespace max3000 {
+
+#ifndef _MAX3000_SIM_H_
+#define _MAX3000_SIM_H_
+
+#define MAX3000_SIM_CPU_HZ 240000000UL    // Clock rate reported by arch_get_cpu_freq_hz()
+#define MAX3000_SIM_CYCLE_READ 24         // CPU cycles spent by each read of the cycle counter
+
+/**
+ * @brief Lines of a chain, in the order of the MAX3000_Config constructor.
+ */
+enum MAX3000_SimLine {
+    MAX3000_SIM_MOSI,
+    MAX3000_SIM_SCLK,
+    MAX3000_SIM_LAT,
+    MAX3000_SIM_RST,
+    MAX3000_SIM_PULSE,
+    MAX3000_SIM_COL,
+    MAX3000_SIM_ROW,
+    MAX3000_SIM_LINES
+};
+
+/**
+ * @brief What the boards have seen since the counters were last reset.
+ */
+struct MAX3000_SimCounters {
+    uint32_t gpioWrites;     // Writes to any simulated pin
+    uint32_t shiftPushes;    // Rising edges on a latch line
+    uint32_t pulses;         // Pulses that reached the boards, counted once per chain
+    uint32_t dotFlips;       // Dots flipped, summed over all boards
+    uint32_t conflicts;      // Boards with both row and column sources on during a pulse
+};
+
+class MAX3000_Simulator;
+
+/**
+ * @brief A simulated output pin, reporting every write to its simulator.
+ */
+class MAX3000_SimPin : public InternalGPIOPin {
+  public:
+    MAX3000_SimPin(MAX3000_Simulator *sim, uint8_t number) : sim(sim), number(number) {}
+
+    void setup() override {}
+    void pin_mode(gpio::Flags flags) override {}
+    bool digital_read() override { return level; }
+    void digital_write(bool value) override;
+    std::string dump_summary() const override { return "SIM" + std::to_string(number); }
+    uint8_t get_pin() const override { return number; }
+    bool is_inverted() const override { return false; }
+
+    bool level = false;
+
+  private:
+    MAX3000_Simulator *sim;
+    uint8_t number;
+};
+
+/**
+ * @brief A simulated SPI peripheral, shifting into the main chain.
+ */
+class MAX3000_SimSPI : public MAX3000_SPI {
+  public:
+    explicit MAX3000_SimSPI(MAX3000_Simulator *sim) : sim(sim) {}
+
+    void begin(void) override {}
+    void transfer(const uint8_t *data, size_t length) override;
+
+  private:
+    MAX3000_Simulator *sim;
+};
+
+/**
+ * @brief A wall of MAX3000 boards on one or more chains.
+ */
+class MAX3000_Simulator {
+  public:
+    /**
+     * @brief Create a wall of boards, all on the main chain to begin with.
+     *
+     * @param numBoards Number of boards on the wall, in chain order.
+     */
+    explicit MAX3000_Simulator(size_t numBoards);
+    ~MAX3000_Simulator(void);
+
+    /**
+     * @brief Pin driving one line of the main chain.
+     */
+    GPIOPin *pin(MAX3000_SimLine line) const { return pins[line]; }
+
+    /**
+     * @brief Configuration for a display covering the wall, with the main chain's pins.
+     *
+     * @param width Width of the display in pixels.
+     * @param height Height of the display in pixels.
+     * @param spi Load the main chain through MAX3000_SimSPI instead of MOSI and CLK.
+     */
+    MAX3000_Config config(uint16_t width, uint16_t height, bool spi = false);
+
+    /**
+     * @brief Move boards from the end of the main chain onto a new chain with its own MOSI.
+     *
+     * @param numBoards Number of boards on the new chain.
+     * @param ownLines Lines besides MOSI that get their own pins, as a mask of 1 << MAX3000_SimLine.
+     * @return The chain, ready for MAX3000_Config::addChain().
+     */
+    MAX3000_Chain addChain(size_t numBoards, uint8_t ownLines = 0);
+
+    /**
+     * @brief State of a dot, in the board's own columns and rows.
+     */
+    bool dot(size_t board, uint8_t col, uint8_t row) const { return dots[board][col * PANEL_HEIGHT + row]; }
+
+    size_t numBoards(void) const { return dots.size(); }
+
+    const MAX3000_SimCounters &counters(void) const { return count; }
+    void resetCounters(void) { count = MAX3000_SimCounters(); }
+
+    /**
+     * @brief Simulated time, moved on by delays and cycle counter reads.
+     */
+    static uint64_t nowCycles(void) { return cycles; }
+    static uint64_t nowUs(void) { return cycles / (MAX3000_SIM_CPU_HZ / 1000000UL); }
+    static void advanceCycles(uint64_t n) { cycles += n; }
+    static void advanceUs(uint64_t us) { cycles += us * (MAX3000_SIM_CPU_HZ / 1000000UL); }
+
+  private:
+    friend class MAX3000_SimPin;
+    friend class MAX3000_SimSPI;
+
+    struct Chain {
+        MAX3000_SimPin *lines[MAX3000_SIM_LINES];
+        size_t firstBoard;
+        size_t numBoards;
+        bool active;                  // Pulse line and both enables were last seen active
+        std::vector<uint8_t> bits;    // Bits clocked in since the last latch, oldest first
+    };
+
+    void pinWritten(MAX3000_SimPin *pin, bool previous);
+    void latch(Chain & chain);
+    void pulse(Chain & chain);
+
+    static uint64_t cycles;
+
+    std::vector<MAX3000_SimPin *> allPins;
+    MAX3000_SimPin *pins[MAX3000_SIM_LINES];
+    MAX3000_SimSPI spiPort;
+    std::vector<Chain> chains;
+    std::vector<uint16_t> registers;           // Latched shift register of each board
+    std::vector<std::vector<uint8_t>> dots;    // Dots of each board, by column then row
+    MAX3000_SimCounters count = MAX3000_SimCounters();
+};
+
+#endif    // _MAX3000_SIM_H_
+
+}  // namespace max3000
+}  // namespace esphome
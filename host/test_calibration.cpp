@@ -0,0 +1,123 @@
+/*!
+ * @file test_calibration.cpp
+ *
+ * Runs the pulse calibration of the MAX3000 component on the simulator, marking failures the way
+ * someone watching the board would, and checks that each kept duration is one step longer than
+ * the one that was on show when the failure was marked.
+ */
+
+#include "max3000.h"
+#include "max3000_sim.h"
+
+#include <cstdio>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+#define PULSE_US 150
+#define STEP_US 10
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+/**
+ * @brief The component, with the durations calibration saved for a board in reach.
+ */
+class CalibratedMAX3000 : public MAX3000 {
+  public:
+    using MAX3000::MAX3000;
+
+    bool savedPulse(int board, uint32_t & set_us, uint32_t & clear_us) const {
+        for(const BoardPulse & pulse : board_pulses_) {
+            if(pulse.board == board) {
+                set_us = pulse.set_us;
+                clear_us = pulse.clear_us;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+enum Shown { SHOWN_MIXED, SHOWN_FILL, SHOWN_CLEAR };
+
+static Shown shown(const MAX3000_Simulator & sim) {
+    int set = 0;
+    for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+            set += sim.dot(0, col, row);
+        }
+    }
+    if(set == PANEL_WIDTH * PANEL_HEIGHT) {
+        return SHOWN_FILL;
+    }
+    return set ? SHOWN_MIXED : SHOWN_CLEAR;
+}
+
+// Marks the clear of one round and the fill of a later one as failed, counting rounds from 1
+static void testMarks(int clearRound, int fillRound) {
+    MAX3000_Simulator sim(1);
+    CalibratedMAX3000 display(1, 1);
+    display.set_mosi_pin(sim.pin(MAX3000_SIM_MOSI));
+    display.set_clk_pin(sim.pin(MAX3000_SIM_SCLK));
+    display.set_latch_pin(sim.pin(MAX3000_SIM_LAT));
+    display.set_reset_pin(sim.pin(MAX3000_SIM_RST));
+    display.set_pulse_pin(sim.pin(MAX3000_SIM_PULSE));
+    display.set_col_pin(sim.pin(MAX3000_SIM_COL));
+    display.set_row_pin(sim.pin(MAX3000_SIM_ROW));
+    display.set_dissolve(false);
+    display.set_pulse_duration(PULSE_US);
+    display.setup();
+
+    display.start_pulse_calibration();
+    int round = 0;
+    while(display.is_calibrating() && (round <= PULSE_US / STEP_US)) {
+        MAX3000_Simulator::advanceUs(2001000ULL);
+        display.loop();
+        Shown now = shown(sim);
+        CHECK(now != SHOWN_MIXED, "round %d: board neither filled nor cleared", round);
+        if(now == SHOWN_FILL) {
+            round++;
+            if(round == fillRound) {
+                display.mark_calibration_failure();
+            }
+        } else if(round == clearRound) {
+            display.mark_calibration_failure();
+        }
+    }
+    CHECK(!display.is_calibrating(), "calibration didn't finish after both failures");
+
+    // Round n runs at PULSE_US - (n - 1) * STEP_US, and one step longer is kept
+    uint32_t set_us = 0, clear_us = 0;
+    CHECK(display.savedPulse(0, set_us, clear_us), "nothing saved for board 0");
+    uint32_t expectedSet = PULSE_US - (fillRound - 2) * STEP_US;
+    uint32_t expectedClear = PULSE_US - (clearRound - 2) * STEP_US;
+    if(expectedSet > PULSE_US) {
+        expectedSet = PULSE_US;
+    }
+    if(expectedClear > PULSE_US) {
+        expectedClear = PULSE_US;
+    }
+    CHECK(set_us == expectedSet, "fill %d failed: kept set %uus, expected %uus", fillRound, set_us, expectedSet);
+    CHECK(clear_us == expectedClear, "clear %d failed: kept clear %uus, expected %uus", clearRound, clear_us,
+          expectedClear);
+}
+
+int main(void) {
+    testMarks(3, 4);
+    testMarks(4, 2);
+    testMarks(1, 1);
+    testMarks(5, 5);
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
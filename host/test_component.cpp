@@ -0,0 +1,93 @@
+/*!
+ * @file test_component.cpp
+ *
+ * Checks the MAX3000 component's own handling of its options on the simulator: priority regions
+ * given in drawing coordinates under every display rotation, and a configuration the display
+ * can't be set up with.
+ */
+
+#include "max3000.h"
+#include "max3000_sim.h"
+
+#include <cstdio>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+#define BOARDS_WIDE 2
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+static void connect(MAX3000 & display, MAX3000_Simulator & sim) {
+    display.set_mosi_pin(sim.pin(MAX3000_SIM_MOSI));
+    display.set_clk_pin(sim.pin(MAX3000_SIM_SCLK));
+    display.set_latch_pin(sim.pin(MAX3000_SIM_LAT));
+    display.set_reset_pin(sim.pin(MAX3000_SIM_RST));
+    display.set_pulse_pin(sim.pin(MAX3000_SIM_PULSE));
+    display.set_col_pin(sim.pin(MAX3000_SIM_COL));
+    display.set_row_pin(sim.pin(MAX3000_SIM_ROW));
+    display.set_dissolve(false);
+}
+
+// The same region, the right half of the second board, in the drawing coordinates of each rotation
+static void testPriorityRotation(display::DisplayRotation rotation, int x, int y, int width, int height) {
+    MAX3000_Simulator sim(BOARDS_WIDE);
+    MAX3000 display(BOARDS_WIDE, 1);
+    connect(display, sim);
+    display.set_rotation(rotation);
+    display.set_flip_budget(8 * PANEL_HEIGHT);
+    display.add_priority_region(x, y, width, height);
+    display.set_writer([](display::DisplayBuffer & it) { it.fill(COLOR_ON); });
+    display.setup();
+    display.update();
+
+    // Each board flips its share of the budget, the second one all of it in the region
+    int inside = 0, outside = 0;
+    for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+            if(sim.dot(1, col, row)) {
+                (col >= PANEL_WIDTH - 8 ? inside : outside)++;
+            }
+        }
+    }
+    CHECK((inside == 4 * PANEL_HEIGHT) && (outside == 0), "rotation %d: %d dots flipped inside the region, %d outside",
+          rotation, inside, outside);
+}
+
+// Chains that take every board leave nothing to allocate buffers for
+static void testFailedSetup(void) {
+    MAX3000_Simulator sim(BOARDS_WIDE);
+    MAX3000 display(BOARDS_WIDE, 1);
+    connect(display, sim);
+    display.add_chain(BOARDS_WIDE, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    display.set_writer([](display::DisplayBuffer & it) { it.fill(COLOR_ON); });
+    display.setup();
+    CHECK(display.is_failed(), "setup with a chain of every board didn't fail");
+
+    // Nothing may touch the missing buffers
+    display.update();
+    display.loop();
+    CHECK(sim.counters().shiftPushes == 0, "a failed display drove the boards");
+}
+
+int main(void) {
+    const int width = BOARDS_WIDE * PANEL_WIDTH;
+    testPriorityRotation(display::DISPLAY_ROTATION_0_DEGREES, width - 8, 0, 8, PANEL_HEIGHT);
+    testPriorityRotation(display::DISPLAY_ROTATION_90_DEGREES, 0, 0, PANEL_HEIGHT, 8);
+    testPriorityRotation(display::DISPLAY_ROTATION_180_DEGREES, 0, 0, 8, PANEL_HEIGHT);
+    testPriorityRotation(display::DISPLAY_ROTATION_270_DEGREES, 0, width - 8, PANEL_HEIGHT, 8);
+    testFailedSetup();
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
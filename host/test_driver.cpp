@@ -0,0 +1,415 @@
+/*!
+ * @file test_driver.cpp
+ *
+ * Drives random frames through MAX3000_Display into the simulator and checks that every dot
+ * on the wall ends up matching the buffer, across board orders, chains, SPI, incremental
+ * updates, the flip budget, and the fast drawing paths.
+ */
+
+#include "max3000_sim.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+// Dots on the wall that differ from the display's buffer
+static int mismatches(const MAX3000_Simulator & sim, MAX3000_Display & display, int rotatedBoard = -1, bool inverted = false) {
+    int bad = 0;
+    for(size_t board = 0; board < sim.numBoards(); board++) {
+        int16_t bx, by;
+        display.getBoardPosition(board, bx, by);
+        for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+            for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+                bool upsideDown = (int) board == rotatedBoard;
+                int16_t x = bx + (upsideDown ? PANEL_WIDTH - 1 - col : col);
+                int16_t y = by + (upsideDown ? PANEL_HEIGHT - 1 - row : row);
+                if(sim.dot(board, col, row) != (display.getPixel(x, y) != inverted)) {
+                    bad++;
+                }
+            }
+        }
+    }
+    return bad;
+}
+
+static void drawRandom(MAX3000_Display & display, int percent) {
+    int density = rand() % 100;
+    for(int x = 0; x < display.width(); x++) {
+        for(int y = 0; y < display.height(); y++) {
+            if(rand() % 100 < percent) {
+                display.drawPixel(x, y, rand() % 100 < density);
+            }
+        }
+    }
+}
+
+// Full frames, with dissolve switched on and off, then an unchanged frame that must not flip anything
+static void testFrames(const char *name, MAX3000_Simulator & sim, MAX3000_Config config, int rotatedBoard = -1) {
+    MAX3000_Display display(config);
+    display.setRotation(0);
+    display.begin();
+    if(rotatedBoard >= 0) {
+        display.setBoardRotation(rotatedBoard, 2);
+    }
+    display.clearDisplay();
+    display.display();
+
+    bool inverted = false;
+    for(int frame = 0; frame < 24; frame++) {
+        display.setDissolveEnable(frame % 4 == 1);
+        if(frame == 16) {
+            inverted = true;
+            display.invertDisplay(true);
+        }
+        drawRandom(display, 20);
+        display.display();
+        int bad = mismatches(sim, display, rotatedBoard, inverted);
+        CHECK(bad == 0, "%s frame %d: %d dots differ", name, frame, bad);
+    }
+
+    sim.resetCounters();
+    display.display();
+    CHECK(sim.counters().pulses == 0, "%s: unchanged frame sent %u pulses", name, sim.counters().pulses);
+    CHECK(sim.counters().conflicts == 0, "%s: %u row and column conflicts", name, sim.counters().conflicts);
+}
+
+static void testLayouts(void) {
+    static const char *const ORDERS[] = { "row major", "row major bounce", "column major", "column major bounce" };
+    for(uint8_t order = 0; order < 4; order++) {
+        MAX3000_Simulator sim(6);
+        MAX3000_Config config = sim.config(3 * PANEL_WIDTH, 2 * PANEL_HEIGHT);
+        config.boardOrder = order;
+        testFrames(ORDERS[order], sim, config, order == 1 ? 4 : -1);
+    }
+
+    MAX3000_Simulator single(1);
+    testFrames("single board", single, single.config(PANEL_WIDTH, PANEL_HEIGHT));
+
+    MAX3000_Simulator spi(4);
+    testFrames("hardware SPI", spi, spi.config(2 * PANEL_WIDTH, 2 * PANEL_HEIGHT, true));
+}
+
+static void testChains(void) {
+    // Uneven chains, one with its own clock and latch and one sharing them
+    MAX3000_Simulator sim(8);
+    MAX3000_Config config = sim.config(4 * PANEL_WIDTH, 2 * PANEL_HEIGHT);
+    config.addChain(sim.addChain(3, (1 << MAX3000_SIM_SCLK) | (1 << MAX3000_SIM_LAT)));
+    config.addChain(sim.addChain(2));
+    testFrames("chains", sim, config);
+
+    // Separate pulse lines too
+    MAX3000_Simulator pulsed(4);
+    MAX3000_Config pulsedConfig = pulsed.config(2 * PANEL_WIDTH, 2 * PANEL_HEIGHT);
+    pulsedConfig.addChain(pulsed.addChain(2, (1 << MAX3000_SIM_PULSE) | (1 << MAX3000_SIM_COL) | (1 << MAX3000_SIM_ROW)));
+    testFrames("chains with own pulse lines", pulsed, pulsedConfig);
+}
+
+// Frames started with beginFrame() and interrupted by newer ones before they finish
+static void testIncremental(void) {
+    MAX3000_Simulator sim(6);
+    MAX3000_Display display(sim.config(3 * PANEL_WIDTH, 2 * PANEL_HEIGHT));
+    display.setRotation(0);
+    display.begin();
+    display.clearDisplay();
+    display.display();
+
+    for(int frame = 0; frame < 40; frame++) {
+        drawRandom(display, 30);
+        display.beginFrame(frame == 20);
+        for(int step = rand() % 5; step > 0; step--) {
+            display.displayStep(1000);
+        }
+        if(frame % 10 == 9) {
+            while(display.displayPending()) {
+                display.displayStep(500);
+            }
+            int bad = mismatches(sim, display);
+            CHECK(bad == 0, "incremental frame %d: %d dots differ", frame, bad);
+        }
+    }
+}
+
+static void testFlipBudget(void) {
+    MAX3000_Simulator sim(2);
+    MAX3000_Display display(sim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    display.begin();
+    display.clearDisplay();
+    display.display();
+
+    // The remainder of a frame over budget is finished by displayStep()
+    display.setFlipBudget(100);
+    display.fillScreen(1);
+    display.display();
+    CHECK(display.getStats().dotFlips <= 100, "budget of 100 flipped %u dots", display.getStats().dotFlips);
+    CHECK(display.displayPending(), "frame over budget isn't pending");
+    while(display.displayPending()) {
+        sim.resetCounters();
+        display.displayStep(1000000);
+        CHECK(sim.counters().dotFlips <= 100, "step flipped %u dots", sim.counters().dotFlips);
+    }
+    CHECK(mismatches(sim, display) == 0, "frame over budget not finished");
+
+    // Dots changed back before their turn are never flipped
+    display.setFlipBudget(2);
+    display.fillScreen(0);
+    display.display();
+    display.fillScreen(1);
+    sim.resetCounters();
+    display.display();
+    while(display.displayPending()) {
+        display.displayStep(1000000);
+    }
+    CHECK(sim.counters().dotFlips <= 4, "%u dots flipped for changes that were undone", sim.counters().dotFlips);
+    CHECK(mismatches(sim, display) == 0, "coalesced frame not finished");
+
+    // A priority region is flipped first, on each board's share of the budget
+    display.setFlipBudget(0);
+    display.fillScreen(0);
+    display.display();
+    display.setPriorityRect(20, 0, 8, 16);
+    display.setFlipBudget(8 * 16);
+    display.fillScreen(1);
+    display.display();
+    int inside = 0, outside = 0;
+    for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+            if(sim.dot(0, col, row)) {
+                (col >= 20 ? inside : outside)++;
+            }
+        }
+    }
+    CHECK((inside == 64) && (outside == 0), "priority region: %d inside, %d outside", inside, outside);
+    while(display.displayPending()) {
+        display.displayStep(1000000);
+    }
+    CHECK(mismatches(sim, display) == 0, "priority frame not finished");
+
+    // Oldest first: dots carried over go before those of the newer frame
+    display.clearPriorityRects();
+    display.setFlipBudget(0);
+    display.fillScreen(0);
+    display.display();
+    display.setFlipOrder(MAX3000_FLIP_OLDEST);
+    display.setFlipBudget(10);
+    display.fillRect(20, 0, 8, 16, 1);
+    display.display();
+    display.fillRect(0, 0, 8, 16, 1);
+    display.display();
+    int left = 0;
+    for(uint8_t col = 0; col < 8; col++) {
+        for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+            left += sim.dot(0, col, row);
+        }
+    }
+    CHECK(left == 0, "oldest order flipped %d new dots before carried ones", left);
+    while(display.displayPending()) {
+        display.displayStep(1000000);
+    }
+    CHECK(mismatches(sim, display) == 0, "oldest frame not finished");
+}
+
+// Windows of a pre-drawn strip, as text scrolling uses
+static void testCopyWindow(void) {
+    MAX3000_Simulator sim(2);
+    MAX3000_Display display(sim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    display.begin();
+    display.clearDisplay();
+    display.display();
+
+    const int stripWidth = 37;
+    uint8_t strip[stripWidth * 2];
+    for(uint8_t & b : strip) {
+        b = rand();
+    }
+    for(int left = -60; left <= 40; left += 3) {
+        display.copyWindow(strip, stripWidth, left);
+        display.display();
+        int bad = 0;
+        for(int x = 0; x < display.width(); x++) {
+            for(int y = 0; y < display.height(); y++) {
+                int sx = x + left;
+                bool expected = (sx >= 0) && (sx < stripWidth) && ((strip[sx + (y / 8) * stripWidth] >> (y & 7)) & 1);
+                bad += display.getPixel(x, y) != expected;
+            }
+        }
+        CHECK(bad == 0, "window at %d: %d pixels differ from the strip", left, bad);
+        CHECK(mismatches(sim, display) == 0, "window at %d not shown", left);
+    }
+}
+
+// The rotation 0 writers agree with drawPixel() at rotation 0, whatever the display rotation
+static void testPixelRot0(void) {
+    MAX3000_Simulator sim(2), referenceSim(2);
+    MAX3000_Display direct(sim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    MAX3000_Display reference(referenceSim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    direct.begin();
+    direct.clearDisplay();
+    direct.display();
+    reference.begin();
+    reference.clearDisplay();
+    direct.setRotation(1);
+    for(int n = 0; n < 2000; n++) {
+        int16_t x = rand() % (2 * PANEL_WIDTH + 4) - 2;
+        int16_t y = rand() % (PANEL_HEIGHT + 4) - 2;
+        bool on = rand() % 3;
+        if(on) {
+            direct.setPixelRot0(x, y);
+        } else {
+            direct.clearPixelRot0(x, y);
+        }
+        reference.drawPixel(x, y, on);
+    }
+    direct.setRotation(0);
+    int bad = 0;
+    for(int x = 0; x < reference.width(); x++) {
+        for(int y = 0; y < reference.height(); y++) {
+            bad += direct.getPixel(x, y) != reference.getPixel(x, y);
+        }
+    }
+    CHECK(bad == 0, "rotation 0 writers: %d pixels differ from drawPixel()", bad);
+    direct.display();
+    CHECK(mismatches(sim, direct) == 0, "rotation 0 writers left dots out of the dirty bytes");
+}
+
+// fillRect() against a drawPixel() loop, at every rotation, with rectangles hanging off the edges
+static void testFillRectRotations(void) {
+    for(uint8_t rotation = 0; rotation < 4; rotation++) {
+        MAX3000_Simulator sim(4), referenceSim(4);
+        MAX3000_Display fast(sim.config(2 * PANEL_WIDTH, 2 * PANEL_HEIGHT));
+        MAX3000_Display reference(referenceSim.config(2 * PANEL_WIDTH, 2 * PANEL_HEIGHT));
+        fast.begin();
+        fast.clearDisplay();
+        fast.display();
+        reference.begin();
+        reference.clearDisplay();
+        fast.setRotation(rotation);
+        reference.setRotation(rotation);
+
+        for(int n = 0; n < 300; n++) {
+            int16_t x = rand() % (fast.width() + 20) - 10;
+            int16_t y = rand() % (fast.height() + 20) - 10;
+            int16_t w = rand() % 40;
+            int16_t h = rand() % 40;
+            uint16_t color = rand() % 3;
+            fast.fillRect(x, y, w, h, color);
+            for(int16_t px = x; px < x + w; px++) {
+                for(int16_t py = y; py < y + h; py++) {
+                    reference.drawPixel(px, py, color);
+                }
+            }
+            if(n % 50 == 49) {
+                fast.display();
+            }
+        }
+
+        int bad = 0;
+        for(int x = 0; x < fast.width(); x++) {
+            for(int y = 0; y < fast.height(); y++) {
+                bad += fast.getPixel(x, y) != reference.getPixel(x, y);
+            }
+        }
+        CHECK(bad == 0, "rotation %u: fillRect differs from drawPixel in %d pixels", rotation, bad);
+        fast.display();
+        fast.setRotation(0);
+        CHECK(mismatches(sim, fast) == 0, "rotation %u: fillRect left dots out of the dirty bytes", rotation);
+    }
+}
+
+// Batched drawing against the same drawing done directly, with far more operations than the
+// batch holds, so it commits early and merges runs of pixels on the way
+static void testDrawBatch(void) {
+    MAX3000_Simulator sim(2), referenceSim(2);
+    MAX3000_Display batched(sim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    MAX3000_Display reference(referenceSim.config(2 * PANEL_WIDTH, PANEL_HEIGHT));
+    batched.begin();
+    reference.begin();
+    for(int x = 0; x < batched.width(); x++) {
+        for(int y = 0; y < batched.height(); y++) {
+            bool on = rand() % 2;
+            batched.drawPixel(x, y, on);
+            reference.drawPixel(x, y, on);
+        }
+    }
+    batched.display();
+
+    MAX3000_DrawBatch batch;
+    batch.begin(&batched, batched.width(), batched.height(), 16);
+    uint32_t added = 0;
+    for(int n = 0; n < 400; n++) {
+        int16_t x = rand() % (batched.width() + 8) - 4;
+        int16_t y = rand() % (batched.height() + 8) - 4;
+        bool on = rand() % 2;
+        switch(rand() % 4) {
+            case 0: {
+                // A horizontal run, merged into one span
+                int16_t length = rand() % 10 + 1;
+                for(int16_t i = 0; i < length; i++, added++) {
+                    batch.addPixel(x + i, y, on);
+                    reference.drawPixel(x + i, y, on);
+                }
+                break;
+            }
+            case 1: {
+                int16_t length = rand() % 10 + 1;
+                for(int16_t i = 0; i < length; i++, added++) {
+                    batch.addPixel(x, y + i, on);
+                    reference.drawPixel(x, y + i, on);
+                }
+                break;
+            }
+            case 2:
+                batch.addPixel(x, y, on);
+                reference.drawPixel(x, y, on);
+                added++;
+                break;
+            default: {
+                int16_t w = rand() % 20, h = rand() % 12;
+                batch.addRect(x, y, w, h, on);
+                reference.fillRect(x, y, w, h, on);
+                added++;
+                break;
+            }
+        }
+    }
+    batch.commit();
+
+    int bad = 0;
+    for(int x = 0; x < batched.width(); x++) {
+        for(int y = 0; y < batched.height(); y++) {
+            bad += batched.getPixel(x, y) != reference.getPixel(x, y);
+        }
+    }
+    CHECK(bad == 0, "batched drawing differs from direct drawing in %d pixels", bad);
+    CHECK(batch.getStats().ops < added, "%u operations recorded for %u drawn, nothing merged", batch.getStats().ops,
+          added);
+    batched.display();
+    CHECK(mismatches(sim, batched) == 0, "batched drawing left dots out of the dirty bytes");
+}
+
+int main(void) {
+    srand(1);
+    testLayouts();
+    testChains();
+    testIncremental();
+    testFlipBudget();
+    testCopyWindow();
+    testPixelRot0();
+    testFillRectRotations();
+    testDrawBatch();
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*!
+ * @file test_frame_sink.cpp
+ *
+ * Sends frame packets to the MAX3000 component over a local UDP socket and checks what ends up
+ * on the simulated boards: whole frames and both kinds of delta, several packets per loop(),
+ * bursts spread over several loops, malformed packets, and the pages taking over again after
+ * the stream stops.
+ */
+
+#include "max3000.h"
+#include "max3000_sim.h"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+#define BOARDS_WIDE 2
+#define WIDTH (BOARDS_WIDE * PANEL_WIDTH)
+#define FRAME_SIZE (WIDTH * 2)
+#define TIMEOUT_MS 1000
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+typedef std::vector<uint8_t> Frame;
+
+class Sender {
+  public:
+    explicit Sender(uint16_t port) {
+        fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    ~Sender(void) { close(fd); }
+
+    void send(uint8_t type, uint8_t sequence, const Frame & body) {
+        Frame packet = { type, sequence };
+        packet.insert(packet.end(), body.begin(), body.end());
+        sendto(fd, packet.data(), packet.size(), 0, (struct sockaddr *) &address, sizeof(address));
+    }
+
+  private:
+    int fd;
+    struct sockaddr_in address = {};
+};
+
+// A port nothing is listening on right now
+static uint16_t freePort(void) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (struct sockaddr *) &address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, (struct sockaddr *) &address, &length);
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+static Frame randomFrame(void) {
+    Frame frame(FRAME_SIZE);
+    for(uint8_t & b : frame) {
+        b = rand();
+    }
+    return frame;
+}
+
+static Frame xorFrames(const Frame & a, const Frame & b) {
+    Frame result(a.size());
+    for(size_t i = 0; i < a.size(); i++) {
+        result[i] = a[i] ^ b[i];
+    }
+    return result;
+}
+
+// The same runs as xor_runs() in display.py
+static Frame xorRuns(const Frame & frame, const Frame & previous) {
+    Frame runs;
+    size_t i = 0;
+    while(i < frame.size()) {
+        size_t j = i;
+        while((j < frame.size()) && (j - i < 128) && (frame[j] == previous[j])) {
+            j++;
+        }
+        if(j > i) {
+            if(j < frame.size()) {
+                runs.push_back(j - i - 1);
+            }
+            i = j;
+            continue;
+        }
+        while((j < frame.size()) && (j - i < 128) && (frame[j] != previous[j])) {
+            j++;
+        }
+        runs.push_back(0x80 | (j - i - 1));
+        for(size_t k = i; k < j; k++) {
+            runs.push_back(frame[k] ^ previous[k]);
+        }
+        i = j;
+    }
+    return runs;
+}
+
+// Dots on the wall that differ from a frame in the buffer layout
+static int mismatches(const MAX3000_Simulator & sim, const Frame & frame) {
+    int bad = 0;
+    for(size_t board = 0; board < BOARDS_WIDE; board++) {
+        for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+            for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+                size_t x = board * PANEL_WIDTH + col;
+                bool expected = (frame[x + (row / 8) * WIDTH] >> (row & 7)) & 1;
+                bad += sim.dot(board, col, row) != expected;
+            }
+        }
+    }
+    return bad;
+}
+
+// Runs the main loop until the packets sent so far have arrived
+static void receive(MAX3000 & display) {
+    usleep(2000);
+    display.loop();
+}
+
+int main(void) {
+    srand(22);
+    MAX3000_Simulator sim(BOARDS_WIDE);
+    MAX3000 display(BOARDS_WIDE, 1);
+    display.set_mosi_pin(sim.pin(MAX3000_SIM_MOSI));
+    display.set_clk_pin(sim.pin(MAX3000_SIM_SCLK));
+    display.set_latch_pin(sim.pin(MAX3000_SIM_LAT));
+    display.set_reset_pin(sim.pin(MAX3000_SIM_RST));
+    display.set_pulse_pin(sim.pin(MAX3000_SIM_PULSE));
+    display.set_col_pin(sim.pin(MAX3000_SIM_COL));
+    display.set_row_pin(sim.pin(MAX3000_SIM_ROW));
+    display.set_dissolve(false);
+    uint16_t port = freePort();
+    display.set_frame_port(port);
+    display.set_frame_timeout(TIMEOUT_MS);
+
+    // The page is a bar down the left of the wall
+    Frame page(FRAME_SIZE, 0);
+    for(int x = 0; x < 10; x++) {
+        page[x] = page[x + WIDTH] = 0xFF;
+    }
+    display.set_writer([](display::DisplayBuffer & it) { it.filled_rectangle(0, 0, 10, 16); });
+    display.setup();
+    display.update();
+    CHECK(mismatches(sim, page) == 0, "page not shown");
+
+    Sender sender(port);
+
+    // Deltas need a whole frame to start from
+    Frame current = page;
+    sender.send(MAX3000_PACKET_XOR, 1, xorFrames(randomFrame(), current));
+    receive(display);
+    CHECK(mismatches(sim, page) == 0, "delta applied without a whole frame before it");
+
+    uint8_t sequence = 7;
+    current = randomFrame();
+    sender.send(MAX3000_PACKET_FULL, sequence, current);
+    receive(display);
+    CHECK(mismatches(sim, current) == 0, "whole frame not shown");
+
+    // While frames arrive, updates leave them alone
+    display.update();
+    CHECK(mismatches(sim, current) == 0, "update drew over the stream");
+
+    for(int n = 0; n < 40; n++) {
+        Frame next = current;
+        for(int changes = rand() % 30; changes > 0; changes--) {
+            next[rand() % FRAME_SIZE] ^= 1 << (rand() % 8);
+        }
+        if(n % 2) {
+            sender.send(MAX3000_PACKET_XOR, ++sequence, xorFrames(next, current));
+        } else {
+            sender.send(MAX3000_PACKET_XOR_RLE, ++sequence, xorRuns(next, current));
+        }
+        current = next;
+        // Some packets queue up before the loop gets to them, and only the last state is shown
+        if(n % 4 != 3) {
+            receive(display);
+            CHECK(mismatches(sim, current) == 0, "delta %d not shown", n);
+        }
+    }
+    receive(display);
+    CHECK(mismatches(sim, current) == 0, "queued deltas not shown");
+
+    // A burst is taken a few packets per loop(), so the loop keeps returning
+    for(int n = 0; n < 20; n++) {
+        Frame next = current;
+        next[rand() % FRAME_SIZE] ^= 1 << (rand() % 8);
+        sender.send(MAX3000_PACKET_XOR, ++sequence, xorFrames(next, current));
+        current = next;
+    }
+    receive(display);
+    CHECK(mismatches(sim, current) != 0, "a burst of 20 packets was taken in one loop");
+    for(int n = 0; n < 3; n++) {
+        display.loop();
+    }
+    CHECK(mismatches(sim, current) == 0, "burst not shown");
+
+    // Malformed packets change nothing
+    sender.send(MAX3000_PACKET_XOR, sequence + 2, xorFrames(randomFrame(), current));
+    sender.send(MAX3000_PACKET_XOR_RLE, sequence + 1, Frame { 0x85, 1, 2 });
+    sender.send(MAX3000_PACKET_FULL, sequence + 1, Frame(FRAME_SIZE - 1, 0xFF));
+    sender.send(MAX3000_PACKET_FULL, sequence + 1, Frame(FRAME_SIZE + 1, 0xFF));
+    sender.send(0x7F, sequence + 1, current);
+    receive(display);
+    CHECK(mismatches(sim, current) == 0, "malformed packet changed the dots");
+
+    // Once the stream goes quiet, the pages take over, and deltas on the old frames are refused
+    MAX3000_Simulator::advanceUs((TIMEOUT_MS + 1) * 1000ULL);
+    display.update();
+    CHECK(mismatches(sim, page) == 0, "page not back after the timeout");
+    sender.send(MAX3000_PACKET_XOR_RLE, ++sequence, xorRuns(randomFrame(), current));
+    receive(display);
+    CHECK(mismatches(sim, page) == 0, "delta applied on top of a page");
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+/*!
+ * @file test_handoff.cpp
+ *
+ * Stress test for the driver task handoff. A writer thread publishes frames as fast as it can
+ * while a driver thread, running the same loop as MAX3000::driver_task_loop_(), acquires them
+ * and flips them onto the simulator. Every acquired frame must be whole, newer than the one
+ * before, and the wall must end up showing the last frame published.
+ */
+
+#include "max3000_sim.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+#define BOARDS_WIDE 2
+#define FRAMES 500000
+
+// Every byte of a frame depends on its number, which is kept in the first four bytes
+static uint8_t frameByte(uint32_t number, size_t i) {
+    uint32_t mixed = (number * 2654435761u) ^ (i * 40503u);
+    return (uint8_t) (mixed >> 13);
+}
+
+static void fillFrame(uint8_t *frame, size_t size, uint32_t number) {
+    memcpy(frame, &number, sizeof(number));
+    for(size_t i = sizeof(number); i < size; i++) {
+        frame[i] = frameByte(number, i);
+    }
+}
+
+static bool frameWhole(const uint8_t *frame, size_t size, uint32_t & number) {
+    memcpy(&number, frame, sizeof(number));
+    for(size_t i = sizeof(number); i < size; i++) {
+        if(frame[i] != frameByte(number, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    MAX3000_Simulator sim(BOARDS_WIDE);
+    MAX3000_Display display(sim.config(BOARDS_WIDE * PANEL_WIDTH, PANEL_HEIGHT));
+    display.begin();
+    display.clearDisplay();
+    display.display();
+    display.setDirtyTracking(false);
+
+    const size_t size = BOARDS_WIDE * PANEL_WIDTH * ((PANEL_HEIGHT + 7) / 8);
+    MAX3000_FrameHandoff handoff;
+    handoff.begin(size);
+
+    std::atomic<bool> writing{true};
+    long acquired = 0, torn = 0, backwards = 0;
+    uint32_t last = 0;
+    std::vector<uint8_t> shown(size);
+
+    std::thread driver([&] {
+        for(;;) {
+            if(handoff.pending()) {
+                const uint8_t *frame = handoff.acquire();
+                if(frame != NULL) {
+                    uint32_t number;
+                    if(!frameWhole(frame, size, number)) {
+                        torn++;
+                    } else if(acquired && (number <= last)) {
+                        backwards++;
+                    }
+                    last = number;
+                    acquired++;
+                    memcpy(shown.data(), frame, size);
+                    display.beginFrame(frame);
+                }
+            }
+            if(display.displayPending()) {
+                display.displayStep(2000);
+                continue;
+            }
+            if(!writing && !handoff.pending()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    for(uint32_t number = 1; number <= FRAMES; number++) {
+        fillFrame(handoff.writeBuffer(), size, number);
+        handoff.publish();
+        if(number % 256 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    writing = false;
+    driver.join();
+
+    int failures = 0;
+    printf("%d frames published, %ld acquired\n", FRAMES, acquired);
+    if(torn || backwards) {
+        printf("FAIL %ld torn frames, %ld out of order\n", torn, backwards);
+        failures++;
+    }
+    if(last != FRAMES) {
+        printf("FAIL last frame acquired was %u, not %u\n", last, FRAMES);
+        failures++;
+    }
+
+    // The dots show the last frame, the frame counter bytes included
+    int bad = 0;
+    for(size_t board = 0; board < BOARDS_WIDE; board++) {
+        for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+            for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+                size_t x = board * PANEL_WIDTH + col;
+                bool expected = (shown[x + (row / 8) * BOARDS_WIDE * PANEL_WIDTH] >> (row & 7)) & 1;
+                bad += sim.dot(board, col, row) != expected;
+            }
+        }
+    }
+    if(bad) {
+        printf("FAIL %d dots differ from the last frame\n", bad);
+        failures++;
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
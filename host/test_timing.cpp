@@ -0,0 +1,120 @@
+/*!
+ * @file test_timing.cpp
+ *
+ * Checks the bit-bang pacing against the simulated cycle counter: loading the shift registers
+ * must take as long as shift_clock_rate asks for, never less, and the model time in the frame
+ * statistics and estimatePulseTimeUs() must agree with it.
+ */
+
+#include "max3000_sim.h"
+
+#include <cstdio>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+// Each wait ends on the first counter read past its target, and starts with one more read
+#define SPIN_OVERSHOOT_CYCLES (2 * MAX3000_SIM_CYCLE_READ)
+
+// Flips one dot on the first board and returns the simulated time display() took
+static uint64_t flipOneDot(MAX3000_Display & display, bool value) {
+    display.drawPixel(3, 4, value);
+    uint64_t start = MAX3000_Simulator::nowCycles();
+    display.display();
+    return MAX3000_Simulator::nowCycles() - start;
+}
+
+static void testShiftClock(uint32_t shiftClockHz, size_t boards, size_t chained) {
+    MAX3000_Simulator sim(boards);
+    MAX3000_Config config = sim.config(boards * PANEL_WIDTH, PANEL_HEIGHT);
+    config.shiftClockHz = shiftClockHz;
+    if(chained) {
+        config.addChain(sim.addChain(chained));
+    }
+    MAX3000_Display display(config);
+    display.begin();
+    display.clearDisplay();
+    display.display();
+
+    uint64_t cycles = flipOneDot(display, true);
+    const MAX3000_Stats & stats = display.getStats();
+    CHECK(stats.pulses == 1, "%uHz: %u pulses for one dot", shiftClockHz, stats.pulses);
+
+    // Waits are the only thing that takes time here, so the frame can't be shorter than the model
+    uint64_t modelCycles = (uint64_t) stats.modelUs * (MAX3000_SIM_CPU_HZ / 1000000UL);
+    size_t longest = (boards - chained > chained) ? boards - chained : chained;
+    uint64_t edges = (uint64_t) stats.shiftPushes * longest * 16 * 3;
+    CHECK(cycles + MAX3000_SIM_CPU_HZ / 1000000UL >= modelCycles, "%uHz: frame took %llu cycles, model says %llu",
+          shiftClockHz, (unsigned long long) cycles, (unsigned long long) modelCycles);
+    CHECK(cycles <= modelCycles + edges * SPIN_OVERSHOOT_CYCLES + 2 * (MAX3000_SIM_CPU_HZ / 1000000UL),
+          "%uHz: frame took %llu cycles, model says %llu", shiftClockHz, (unsigned long long) cycles,
+          (unsigned long long) modelCycles);
+
+    // One push of the longest chain, at the configured rate
+    if(shiftClockHz) {
+        uint64_t shiftUs = (uint64_t) stats.shiftPushes * longest * 16 * 1000000UL / shiftClockHz;
+        CHECK(stats.modelUs >= shiftUs, "%uHz: model %uus leaves out shifting %lluus", shiftClockHz, stats.modelUs,
+              (unsigned long long) shiftUs);
+    }
+
+    // estimatePulseTimeUs() is what one pulse costs, shifting included
+    CHECK(stats.shiftPushes == 1, "%uHz: %u pushes for one dot", shiftClockHz, stats.shiftPushes);
+    CHECK(display.estimatePulseTimeUs() == stats.modelUs, "%uHz with %u chained: estimate %uus, model %uus",
+          shiftClockHz, (unsigned) chained, display.estimatePulseTimeUs(), stats.modelUs);
+
+    CHECK(sim.dot(0, 3, 4), "%uHz: dot not set", shiftClockHz);
+}
+
+// A board given a longer pulse of its own sets the estimate, as it holds up the pulses it's in
+static void testBoardPulses(void) {
+    MAX3000_Simulator sim(3);
+    MAX3000_Display display(sim.config(3 * PANEL_WIDTH, PANEL_HEIGHT));
+    display.begin();
+    display.clearDisplay();
+    display.display();
+    display.setPulseDurationUs(100);
+    uint32_t base = display.estimatePulseTimeUs();
+
+    display.setBoardPulseDurationUs(2, 120, 180);
+    CHECK(display.estimatePulseTimeUs() == base + 80, "estimate %uus with a board at 180us, %uus without",
+          display.estimatePulseTimeUs(), base);
+    display.drawPixel(2 * PANEL_WIDTH + 3, 4, 1);
+    display.display();
+    display.drawPixel(2 * PANEL_WIDTH + 3, 4, 0);
+    display.display();
+    CHECK(display.getStats().modelUs <= display.estimatePulseTimeUs(), "clear pulse took %uus, estimate %uus",
+          display.getStats().modelUs, display.estimatePulseTimeUs());
+
+    // Shorter board pulses don't bring it below the display's own
+    display.setBoardPulseDurationUs(2, 50, 50);
+    CHECK(display.estimatePulseTimeUs() == base, "estimate %uus with shorter board pulses, %uus without",
+          display.estimatePulseTimeUs(), base);
+}
+
+int main(void) {
+    CHECK(arch_get_cpu_freq_hz() == MAX3000_SIM_CPU_HZ, "unexpected CPU frequency");
+
+    testShiftClock(0, 2, 0);
+    testShiftClock(50000, 2, 0);
+    testShiftClock(111111, 3, 0);
+    testShiftClock(500000, 1, 0);
+    testShiftClock(2000000, 4, 0);
+    testShiftClock(111111, 4, 2);
+    testShiftClock(111111, 5, 3);
+    testBoardPulses();
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+/*!
+ * @file test_transitions.cpp
+ *
+ * Plays every registered transition on the simulator, step by step as MAX3000 does, and checks
+ * that its last step is the 'after' frame, that the dots end up showing it, and that
+ * estimateCost() predicts the steps, dot flips and pulses the simulated boards actually saw.
+ */
+
+#include "max3000_sim.h"
+#include "MAX3000_Transitions.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace esphome;
+using namespace esphome::max3000;
+
+#define BOARDS_WIDE 2
+#define BOARDS_HIGH 2
+#define WIDTH (BOARDS_WIDE * PANEL_WIDTH)
+#define HEIGHT (BOARDS_HIGH * PANEL_HEIGHT)
+#define FRAME_SIZE (WIDTH * HEIGHT / 8)
+
+static int failures = 0;
+
+#define CHECK(_cond, ...)                                          \
+    do {                                                           \
+        if(!(_cond)) {                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);            \
+            printf(__VA_ARGS__);                                   \
+            printf("\n");                                          \
+            failures++;                                            \
+        }                                                          \
+    } while(0)
+
+typedef std::vector<uint8_t> Frame;
+
+// A frame with a block of dots set, and a few scattered ones, so the two frames differ in places only
+static Frame randomFrame(void) {
+    Frame frame(FRAME_SIZE, 0);
+    int x0 = rand() % WIDTH, y0 = rand() % HEIGHT;
+    for(int x = x0; x < x0 + 20 && x < WIDTH; x++) {
+        for(int y = y0; y < y0 + 12 && y < HEIGHT; y++) {
+            frame[x + (y / 8) * WIDTH] |= 1 << (y & 7);
+        }
+    }
+    for(int n = 0; n < 100; n++) {
+        frame[rand() % FRAME_SIZE] ^= 1 << (rand() % 8);
+    }
+    return frame;
+}
+
+// Transitions whose last step still shows their bar, or the 'after' frame pushed in all but one column
+static bool endsOnBar(const MAX3000_Transition *transition) {
+    static const char *const NAMES[] = { "wipe", "curtain", "vertical", "push" };
+    for(const char *name : NAMES) {
+        if(strcmp(transition->name(), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void testTransition(const MAX3000_Transition *transition, Frame before, Frame after) {
+    MAX3000_Simulator sim(BOARDS_WIDE * BOARDS_HIGH);
+    MAX3000_Display display(sim.config(WIDTH, HEIGHT));
+    display.begin();
+    display.setDissolveEnable(false);
+    display.replaceBuffer(before.data());
+    display.display();
+
+    Frame scratch(FRAME_SIZE);
+    MAX3000_TransitionFrames frames = { before.data(), after.data(), scratch.data(), WIDTH, HEIGHT };
+    MAX3000_TransitionCost cost = transition->estimateCost(frames, display.estimatePulseTimeUs(), 0);
+
+    // Played the way MAX3000::step_transition_() does, ending with the 'after' frame
+    sim.resetCounters();
+    uint32_t steps = 0;
+    int numSteps = transition->numSteps(WIDTH, HEIGHT);
+    for(int step = transition->nextStep(-1, frames); step < numSteps; step = transition->nextStep(step, frames)) {
+        transition->compose(step, frames);
+        display.replaceBuffer(scratch.data());
+        display.display();
+        steps++;
+    }
+    // The last step shows the 'after' frame already, except where the transition leaves it to the
+    // player to take away its bar or its last column of push
+    int leftover = 0;
+    for(int x = 0; x < WIDTH; x++) {
+        for(int y = 0; y < HEIGHT; y++) {
+            bool expected = (after[x + (y / 8) * WIDTH] >> (y & 7)) & 1;
+            leftover += display.getPixel(x, y) != expected;
+        }
+    }
+    if(!endsOnBar(transition)) {
+        CHECK(leftover == 0, "%s: last step differs from the after frame in %d pixels", transition->name(),
+              leftover);
+    }
+    display.replaceBuffer(after.data());
+    display.display();
+    const MAX3000_SimCounters & counters = sim.counters();
+
+    int bad = 0;
+    for(size_t board = 0; board < sim.numBoards(); board++) {
+        int16_t bx, by;
+        display.getBoardPosition(board, bx, by);
+        for(uint8_t col = 0; col < PANEL_WIDTH; col++) {
+            for(uint8_t row = 0; row < PANEL_HEIGHT; row++) {
+                bool expected = (after[bx + col + ((by + row) / 8) * WIDTH] >> ((by + row) & 7)) & 1;
+                bad += sim.dot(board, col, row) != expected;
+            }
+        }
+    }
+    CHECK(bad == 0, "%s: %d dots don't show the after frame", transition->name(), bad);
+
+    CHECK(cost.steps == steps, "%s: estimated %u steps, played %u", transition->name(), cost.steps, steps);
+    CHECK(cost.dotFlips == counters.dotFlips, "%s: estimated %u flips, the boards saw %u", transition->name(),
+          cost.dotFlips, counters.dotFlips);
+    CHECK(cost.pulses == counters.pulses, "%s: estimated %u pulses, the boards saw %u", transition->name(),
+          cost.pulses, counters.pulses);
+}
+
+int main(void) {
+    srand(9);
+    CHECK(MAX3000_numTransitions() >= 9, "only %u transitions registered", (unsigned) MAX3000_numTransitions());
+    for(size_t i = 1; i <= MAX3000_numTransitions(); i++) {
+        const MAX3000_Transition *transition = MAX3000_findTransition((int) i);
+        CHECK(MAX3000_findTransition(transition->name()) == transition, "%s not found by name", transition->name());
+        for(int n = 0; n < 4; n++) {
+            testTransition(transition, randomFrame(), randomFrame());
+        }
+        // Identical frames, which the reveal transitions skip over entirely
+        Frame same = randomFrame();
+        testTransition(transition, same, same);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
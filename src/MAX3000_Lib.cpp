@@ -24,32 +24,63 @@
 
 #include "MAX3000_Lib.h"
 
+#ifdef USE_ESP32
+#include "soc/gpio_reg.h"
+#endif
+
 static const char *const TAG = "max3000_base";
 
 
 namespace esphome {
 namespace max3000 {
 
-// Extra delay when bitbanging on ESP32, which updates much faster than AVR
-#if defined(ESP32) || defined(ESP8266) || defined(ARDUINO_ARCH_STM32)
-#define BITBANG_DELAY delayMicroseconds(3);
-#else
-#define BITBANG_DELAY
-#endif
+// Pin writes and waits are counted into the frame statistics
+#define MAX3000_WRITE(_pin, _v) { _pin->digital_write(_v); stats.gpioWrites++; }
+#define MAX3000_WAIT(_us) { delayMicroseconds(_us); stats.modelUs += (_us); }
+
+// Driver pins go straight to the GPIO registers when they could all be resolved
+#define MAX3000_PIN_WRITE(_pin, _fast, _v)                                 \
+    {                                                                       \
+        if(fastGpio) {                                                      \
+            *((_v) ? (_fast).setReg : (_fast).clearReg) = (_fast).mask;     \
+        } else {                                                            \
+            _pin->digital_write(_v);                                        \
+        }                                                                   \
+        stats.gpioWrites++;                                                 \
+    }
+
+// Paces bit-banging to config.shiftClockHz by spinning on the CPU cycle counter
+#define BITBANG_DELAY                                                            \
+    if(bitbangCycles) {                                                          \
+        uint32_t _start = arch_get_cpu_cycle_count();                            \
+        while(arch_get_cpu_cycle_count() - _start < bitbangCycles) {             \
+        }                                                                        \
+    }
+
+#define MARK_DIRTY(_o) dirtyBytes[(_o) >> 3] |= (1 << ((_o) & 7));
+#define IS_DIRTY(_o) (dirtyBytes[(_o) >> 3] & (1 << ((_o) & 7)))
 
 #define MAX3000_swap(a, b) (((a) ^= (b)), ((b) ^= (a)), ((a) ^= (b)))
 #define LOAD_SR(_b, _p, _e)     \
     shiftReg[_b] &= ~(1 << _p); \
     shiftReg[_b] |= ((_e ? 1 : 0) << _p);
 
-#define MAX3000_LATCH config.lat_pin->digital_write(1);          ///< Shift Register Latch
-#define MAX3000_UNLATCH config.lat_pin->digital_write(0);         ///< Shift Register Unlatch
-#define MAX3000_PULSE config.pulse_pin->digital_write(1);        ///< PULSE_ENABLE active
-#define MAX3000_UNPULSE config.pulse_pin->digital_write(0);       ///< PULSE_ENABLE inactive
-#define MAX3000_PULSE_ROW config.row_pin->digital_write(0);       ///< ROW_ENABLE_N active
-#define MAX3000_UNPULSE_ROW config.row_pin->digital_write(1);    ///< ROW_ENABLE_N inactive
-#define MAX3000_PULSE_COL config.col_pin->digital_write(0);       ///< COL_ENABLE_N active
-#define MAX3000_UNPULSE_COL config.col_pin->digital_write(1);    ///< COL_ENABLE_N inactive
+// Writes a line of every extra chain that has its own, right after the main chain's
+#define MAX3000_CHAINS_WRITE(_pin, _fast, _v)                                    \
+    for(uint8_t _c = 0; _c < config.numChains; ++_c) {                           \
+        if(config.chains[_c]._pin != NULL) {                                     \
+            MAX3000_PIN_WRITE(config.chains[_c]._pin, chainFast[_c]._fast, _v)   \
+        }                                                                        \
+    }
+
+#define MAX3000_LATCH MAX3000_PIN_WRITE(config.lat_pin, fastLat, 1) MAX3000_CHAINS_WRITE(lat_pin, fastLat, 1)            ///< Shift Register Latch
+#define MAX3000_UNLATCH MAX3000_PIN_WRITE(config.lat_pin, fastLat, 0) MAX3000_CHAINS_WRITE(lat_pin, fastLat, 0)          ///< Shift Register Unlatch
+#define MAX3000_PULSE MAX3000_PIN_WRITE(config.pulse_pin, fastPulse, 1) MAX3000_CHAINS_WRITE(pulse_pin, fastPulse, 1)    ///< PULSE_ENABLE active
+#define MAX3000_UNPULSE MAX3000_PIN_WRITE(config.pulse_pin, fastPulse, 0) MAX3000_CHAINS_WRITE(pulse_pin, fastPulse, 0)  ///< PULSE_ENABLE inactive
+#define MAX3000_PULSE_ROW MAX3000_PIN_WRITE(config.row_pin, fastRow, 0) MAX3000_CHAINS_WRITE(row_pin, fastRow, 0)        ///< ROW_ENABLE_N active
+#define MAX3000_UNPULSE_ROW MAX3000_PIN_WRITE(config.row_pin, fastRow, 1) MAX3000_CHAINS_WRITE(row_pin, fastRow, 1)      ///< ROW_ENABLE_N inactive
+#define MAX3000_PULSE_COL MAX3000_PIN_WRITE(config.col_pin, fastCol, 0) MAX3000_CHAINS_WRITE(col_pin, fastCol, 0)        ///< COL_ENABLE_N active
+#define MAX3000_UNPULSE_COL MAX3000_PIN_WRITE(config.col_pin, fastCol, 1) MAX3000_CHAINS_WRITE(col_pin, fastCol, 1)      ///< COL_ENABLE_N inactive
 
 // Shift Register bit definitions on each driver
 #define SR_PIN_COL_A2 0
@@ -65,17 +96,67 @@ namespace max3000 {
 #define SR_PIN_COL_BANK1 11
 #define SR_PIN_USER_LED 13
 
+// All decoder input bits of the shift register
+#define SR_DECODER_MASK                                                                                  \
+    ((1 << SR_PIN_COL_A2) | (1 << SR_PIN_COL_A1) | (1 << SR_PIN_COL_A0) | (1 << SR_PIN_ROW_A0) |         \
+     (1 << SR_PIN_ROW_A1) | (1 << SR_PIN_ROW_A2) | (1 << SR_PIN_ROW_BANK) | (1 << SR_PIN_COL_BANK0) |    \
+     (1 << SR_PIN_COL_BANK1))
+
+// Map sequential rows and columns to the hardware pins
+static constexpr uint8_t colToCode[] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
+    15, 14, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
+static constexpr uint8_t rowToCode[] = { 14, 1, 15, 0, 12, 3, 13, 2, 10, 5, 11, 4, 8, 7, 9, 6 };
+
+// Decoder inputs selecting one pixel of a panel. Rows are reversed on the panel.
+static constexpr uint16_t decoderWord(uint8_t rowCode, uint8_t colCode) {
+    return (((colCode % 8) & 0x4) ? (1 << SR_PIN_COL_A2) : 0) |
+           (((colCode % 8) & 0x2) ? (1 << SR_PIN_COL_A1) : 0) |
+           (((colCode % 8) & 0x1) ? (1 << SR_PIN_COL_A0) : 0) |
+           (((rowCode % 8) & 0x4) ? (1 << SR_PIN_ROW_A2) : 0) |
+           (((rowCode % 8) & 0x2) ? (1 << SR_PIN_ROW_A1) : 0) |
+           (((rowCode % 8) & 0x1) ? (1 << SR_PIN_ROW_A0) : 0) |
+           (((rowCode / 8) & 0x1) ? (1 << SR_PIN_ROW_BANK) : 0) |
+           (((colCode / 8) & 0x2) ? (1 << SR_PIN_COL_BANK1) : 0) |
+           (((colCode / 8) & 0x1) ? (1 << SR_PIN_COL_BANK0) : 0);
+}
+
+// Expands to the decoder words of panel positions _i onwards, indexed by row * PANEL_WIDTH + column
+#define DECODER_WORD(_i) decoderWord(rowToCode[15 - (_i) / PANEL_WIDTH], colToCode[(_i) % PANEL_WIDTH])
+#define DECODER_WORDS_4(_i) DECODER_WORD(_i), DECODER_WORD(_i + 1), DECODER_WORD(_i + 2), DECODER_WORD(_i + 3)
+#define DECODER_WORDS_16(_i) DECODER_WORDS_4(_i), DECODER_WORDS_4(_i + 4), DECODER_WORDS_4(_i + 8), DECODER_WORDS_4(_i + 12)
+#define DECODER_WORDS_64(_i) DECODER_WORDS_16(_i), DECODER_WORDS_16(_i + 16), DECODER_WORDS_16(_i + 32), DECODER_WORDS_16(_i + 48)
+
+// Built at compile time, so selecting a pixel is a single masked store
+static constexpr uint16_t decoderWords[PANEL_HEIGHT * PANEL_WIDTH] = {
+    DECODER_WORDS_64(0), DECODER_WORDS_64(64), DECODER_WORDS_64(128), DECODER_WORDS_64(192),
+    DECODER_WORDS_64(256), DECODER_WORDS_64(320), DECODER_WORDS_64(384)
+};
+static_assert(PANEL_HEIGHT * PANEL_WIDTH == 7 * 64, "decoderWords must cover every panel position");
+
 MAX3000_Base::MAX3000_Base(const MAX3000_Config & config_)
     : config(config_) {
-    localWidth          = config.width;
-    localHeight         = config.height;
+    bufferSize = (size_t)config.width * ((config.height + 7) / 8);
+    setDisplayRotation(0);
     invertEnabled   = false;
     dissolveEnabled = false;
     constantRate    = false;
     firstUpdate     = true;
-
-    // 250uS has been determined to be a decent compromise between frame rate and flip reliability
+    frameActive     = false;
+    forcePending    = false;
+    trackDirty      = true;
+    framePacketValid = false;
+    flipBudget      = 0;
+    flipOrder       = MAX3000_FLIP_SPATIAL;
+    priorityEnabled = false;
+    mainBoards      = config.numVBoards * config.numHBoards;
+    longestChain    = mainBoards;
+    memset(&stats, 0, sizeof(stats));
+
+    // 150uS has been determined to be a decent compromise between frame rate and flip reliability
     pulseDuration = 150;
+    setPulseUs    = NULL;
+    boardRotation = NULL;
+    clearPulseUs  = NULL;
 }
 
 MAX3000_Base::~MAX3000_Base(void) {
@@ -84,17 +165,60 @@ MAX3000_Base::~MAX3000_Base(void) {
 
 inline void
 MAX3000_Base::shiftRegWrite() {
-    // Push each board through the chain, starting with the last board
-    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+    // The latched outputs hold until the next latch, so an unchanged image doesn't need shifting again
+    size_t imageSize = config.numHBoards * config.numVBoards * sizeof(uint16_t);
+    if(latchedValid && memcmp(shiftReg, latchedReg, imageSize) == 0) {
+        stats.skippedPushes++;
+        return;
+    }
+    memcpy(latchedReg, shiftReg, imageSize);
+    latchedValid = true;
+
+    if(config.spi != NULL) {
+        // Pack the chain MSB first, in the same order it would be bit-banged,
+        // and send it all in a single transfer.
+        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+            spiBuffer[board * 2]     = shiftReg[board] >> 8;
+            spiBuffer[board * 2 + 1] = shiftReg[board] & 0xFF;
+        }
+        config.spi->transfer(spiBuffer, config.numHBoards * config.numVBoards * 2);
+        stats.shiftPushes++;
+
+        MAX3000_LATCH
+        MAX3000_UNLATCH
+        return;
+    }
+
+    // Push each board through the chains, starting with the last board. All chains share
+    // the bit timing, so the longest one sets the time. Shorter chains are padded at the
+    // start, and the padding falls off their far end.
+    uint16_t chainWord[MAX3000_MAX_CHAINS];
+    for(size_t step = 0; step < longestChain; ++step) {
+        size_t pad = longestChain - mainBoards;
+        uint16_t word = (step >= pad) ? shiftReg[step - pad] : 0;
+        for(uint8_t c = 0; c < config.numChains; ++c) {
+            pad          = longestChain - config.chains[c].numBoards;
+            chainWord[c] = (step >= pad) ? shiftReg[chainStart[c] + step - pad] : 0;
+        }
         for(uint16_t bit = 0x8000; bit; bit >>= 1) {
-            config.mosi_pin->digital_write((bool)(shiftReg[board] & bit));
+            MAX3000_PIN_WRITE(config.mosi_pin, fastMosi, (bool)(word & bit))
+            for(uint8_t c = 0; c < config.numChains; ++c) {
+                MAX3000_PIN_WRITE(config.chains[c].mosi_pin, chainFast[c].fastMosi, (bool)(chainWord[c] & bit))
+            }
             BITBANG_DELAY
-            config.sclk_pin->digital_write(1);
+            MAX3000_PIN_WRITE(config.sclk_pin, fastSclk, 1)
+            MAX3000_CHAINS_WRITE(sclk_pin, fastSclk, 1)
             BITBANG_DELAY
-            config.sclk_pin->digital_write(0);
+            MAX3000_PIN_WRITE(config.sclk_pin, fastSclk, 0)
+            MAX3000_CHAINS_WRITE(sclk_pin, fastSclk, 0)
             BITBANG_DELAY
         }
     }
+    if(config.shiftClockHz) {
+        stats.modelUs += longestChain * 16 * 1000000UL / config.shiftClockHz;
+    }
+
+    stats.shiftPushes++;
 
     // Once shift register buffer has been shifted in, latch the output pins.
     MAX3000_LATCH
@@ -106,27 +230,116 @@ bool MAX3000_Base::begin(bool reset, bool periphBegin) {
     sprintf(copy, "[BEGIN] shifreg: %d", int(config.numVBoards * config.numHBoards));
     ESP_LOGCONFIG(TAG, copy);
 
+    // Extra chains take their boards off the end of the main chain
+    mainBoards   = config.numVBoards * config.numHBoards;
+    longestChain = 0;
+    for(uint8_t c = 0; c < config.numChains; ++c) {
+        if(config.chains[c].numBoards >= mainBoards) {
+            ESP_LOGE(TAG, "Chains have more boards than the display");
+            return false;
+        }
+        mainBoards -= config.chains[c].numBoards;
+        if(config.chains[c].numBoards > longestChain) {
+            longestChain = config.chains[c].numBoards;
+        }
+    }
+    if(mainBoards > longestChain) {
+        longestChain = mainBoards;
+    }
+    size_t nextBoard = mainBoards;
+    for(uint8_t c = 0; c < config.numChains; ++c) {
+        chainStart[c] = nextBoard;
+        nextBoard += config.chains[c].numBoards;
+    }
+    if(config.numChains && config.spi != NULL) {
+        ESP_LOGE(TAG, "Extra chains can't be used with hardware SPI");
+        return false;
+    }
+
     // Set up the memory
-    buffer = new uint8_t[BUFFER_SIZE];
-    oldBuffer = new uint8_t[BUFFER_SIZE];
+    buffer = new uint8_t[bufferSize];
+    oldBuffer = new uint8_t[bufferSize];
+    dirtyBytes = new uint8_t[(bufferSize + 7) / 8];
     shiftReg = new uint16_t[config.numVBoards * config.numHBoards];
+    latchedReg = new uint16_t[config.numVBoards * config.numHBoards];
+    latchedValid = false;
+    spiBuffer = (config.spi != NULL) ? new uint8_t[config.numVBoards * config.numHBoards * 2] : NULL;
+
+    memset(buffer, 0, bufferSize);
+    memset(oldBuffer, 0, bufferSize);
+    memset(dirtyBytes, 0, (bufferSize + 7) / 8);
+    priorityMask = new uint8_t[bufferSize];
+    carriedMask = new uint8_t[bufferSize];
+    memset(priorityMask, 0, bufferSize);
+    memset(carriedMask, 0, bufferSize);
+
+    // Worst case every pixel of every board changes
+    changes = new MAX3000_Change[config.numVBoards * config.numHBoards * PANEL_HEIGHT * PANEL_WIDTH];
+    boardChanges = new size_t[config.numVBoards * config.numHBoards + 1];
+    boardSplit = new size_t[config.numVBoards * config.numHBoards];
+    setCursor = new size_t[config.numVBoards * config.numHBoards];
+    clearCursor = new size_t[config.numVBoards * config.numHBoards];
+    // Where each board in the chain sits in the buffer, worked out once for the pulse loop
+    boardOffset = new size_t[config.numVBoards * config.numHBoards];
+    boardRotation = new uint8_t[config.numVBoards * config.numHBoards];
+    for(size_t board = 0; board < config.numVBoards * config.numHBoards; ++board) {
+        int16_t x, y;
+        getBoardPosition(board, x, y);
+        boardOffset[board]   = x + (y / 8) * config.width;
+        boardRotation[board] = 0;
+    }
 
-
-    memset(buffer, 0, BUFFER_SIZE);
-    memset(oldBuffer, 0, BUFFER_SIZE);
-
-    //ESP_LOGCONFIG(TAG, "[BEGIN] Shuffle");
-    // Create initial index buffer, which will get shuffled on the first load.
-    // Each panel received the same shuffled index for space concerns.
-    for(int i = 0; i < PANEL_HEIGHT * PANEL_WIDTH; i++) {
-        shuffledIndex[i] = i;
+    setPulseUs = new uint16_t[config.numVBoards * config.numHBoards];
+    clearPulseUs = new uint16_t[config.numVBoards * config.numHBoards];
+    for(size_t board = 0; board < config.numVBoards * config.numHBoards; ++board) {
+        setPulseUs[board]   = pulseDuration;
+        clearPulseUs[board] = pulseDuration;
     }
-    shuffleIndex();
+    setPending = new uint32_t[(config.numVBoards * config.numHBoards + 31) / 32];
+    clearPending = new uint32_t[(config.numVBoards * config.numHBoards + 31) / 32];
+    memset(boardChanges, 0, (config.numVBoards * config.numHBoards + 1) * sizeof(size_t));
+    memset(boardSplit, 0, config.numVBoards * config.numHBoards * sizeof(size_t));
 
     memset(shiftReg, 0, config.numVBoards * config.numHBoards * sizeof(uint16_t));
 
+    // Three edges per bit, each followed by a wait
+    bitbangCycles = config.shiftClockHz ? arch_get_cpu_freq_hz() / (3 * config.shiftClockHz) : 0;
+
+    // Resolve the pins once, and only write them directly if all of them can be
+    fastGpio = false;
+    if(config.fastGpio) {
+        bool resolved = resolveFastPin(config.lat_pin, fastLat) && resolveFastPin(config.pulse_pin, fastPulse) &&
+                        resolveFastPin(config.col_pin, fastCol) && resolveFastPin(config.row_pin, fastRow);
+        if(config.spi == NULL) {
+            resolved = resolved && resolveFastPin(config.mosi_pin, fastMosi) && resolveFastPin(config.sclk_pin, fastSclk);
+        }
+        for(uint8_t c = 0; c < config.numChains; ++c) {
+            // Lines shared with the main chain have no pin of their own
+            const MAX3000_Chain & chain = config.chains[c];
+            MAX3000_ChainFastPins & fast = chainFast[c];
+            resolved = resolved && resolveFastPin(chain.mosi_pin, fast.fastMosi) &&
+                       (chain.sclk_pin == NULL || resolveFastPin(chain.sclk_pin, fast.fastSclk)) &&
+                       (chain.lat_pin == NULL || resolveFastPin(chain.lat_pin, fast.fastLat)) &&
+                       (chain.pulse_pin == NULL || resolveFastPin(chain.pulse_pin, fast.fastPulse)) &&
+                       (chain.col_pin == NULL || resolveFastPin(chain.col_pin, fast.fastCol)) &&
+                       (chain.row_pin == NULL || resolveFastPin(chain.row_pin, fast.fastRow));
+        }
+        if(resolved) {
+            fastGpio = true;
+        } else {
+            ESP_LOGW(TAG, "Pins can't be written directly, using GPIOPin instead");
+        }
+    }
+
     // Initialize SPI (either hardware or software)
-    config.sclk_pin->digital_write(0);
+    if(config.spi != NULL) {
+        if(periphBegin) {
+            config.spi->begin();
+        }
+    } else {
+        MAX3000_PIN_WRITE(config.sclk_pin, fastSclk, 0)
+        MAX3000_CHAINS_WRITE(sclk_pin, fastSclk, 0)
+    }
 
 
     // Set initial non-pulse state
@@ -136,72 +349,349 @@ bool MAX3000_Base::begin(bool reset, bool periphBegin) {
 
     // Reset MAX3000 if requested and reset pin specified in constructor
     if(reset) {
-        config.rst_pin->digital_write(1);
+        MAX3000_WRITE(config.rst_pin, 1)
         delay(1);
-        config.rst_pin->digital_write(0);
+        MAX3000_WRITE(config.rst_pin, 0)
         delay(10);
-        config.rst_pin->digital_write(1);
+        MAX3000_WRITE(config.rst_pin, 1)
         delay(5);
     }
     return true;
 }
 
+bool MAX3000_Base::resolveFastPin(GPIOPin *pin, MAX3000_FastPin & fast) {
+#ifdef USE_ESP32
+    if((pin == NULL) || !pin->is_internal()) {
+        return false;
+    }
+    InternalGPIOPin *internal = static_cast<InternalGPIOPin *>(pin);
+    uint8_t number = internal->get_pin();
+
+    volatile uint32_t *setReg   = (volatile uint32_t *) GPIO_OUT_W1TS_REG;
+    volatile uint32_t *clearReg = (volatile uint32_t *) GPIO_OUT_W1TC_REG;
+#ifdef GPIO_OUT1_W1TS_REG
+    if(number >= 32) {
+        // Pins 32 and up live in the second bank
+        setReg   = (volatile uint32_t *) GPIO_OUT1_W1TS_REG;
+        clearReg = (volatile uint32_t *) GPIO_OUT1_W1TC_REG;
+        number -= 32;
+    }
+#endif
+    if(number >= 32) {
+        return false;
+    }
+
+    // An inverted pin is driven high by clearing it
+    fast.setReg   = internal->is_inverted() ? clearReg : setReg;
+    fast.clearReg = internal->is_inverted() ? setReg : clearReg;
+    fast.mask     = 1UL << number;
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <uint8_t ROTATION>
+inline bool MAX3000_Base::rotateToBuffer(int16_t & x, int16_t & y) const {
+    // With the rotation known at compile time, both the bounds and the switch fold away
+    int16_t w = (ROTATION & 1) ? config.height : config.width;
+    int16_t h = (ROTATION & 1) ? config.width : config.height;
+    if((x < 0) || (x >= w) || (y < 0) || (y >= h)) {
+        return false;    // Pixel out of bounds
+    }
+    switch(ROTATION) {
+        case 1:
+            MAX3000_swap(x, y);
+            x = config.width - x - 1;
+            break;
+        case 2:
+            x = config.width - x - 1;
+            y = config.height - y - 1;
+            break;
+        case 3:
+            MAX3000_swap(x, y);
+            y = config.height - y - 1;
+            break;
+    }
+    return true;
+}
+
+template <uint8_t ROTATION, uint16_t COLOR>
+void MAX3000_Base::writePixel(int16_t x, int16_t y) {
+    if(!rotateToBuffer<ROTATION>(x, y)) {
+        return;
+    }
+
+    size_t offset = x + (y / 8) * config.width;
+    switch(COLOR) {
+        case MAX3000_LIGHT:
+            buffer[offset] |= (1 << (y & 7));
+            break;
+        case MAX3000_DARK:
+            buffer[offset] &= ~(1 << (y & 7));
+            break;
+        case MAX3000_INVERSE:
+            buffer[offset] ^= (1 << (y & 7));
+            break;
+    }
+    if(trackDirty && buffer[offset] != oldBuffer[offset]) {
+        MARK_DIRTY(offset)
+    }
+}
+
+template <uint8_t ROTATION>
+bool MAX3000_Base::readPixel(int16_t x, int16_t y) const {
+    if(!rotateToBuffer<ROTATION>(x, y)) {
+        return false;
+    }
+    return buffer[x + (y / 8) * config.width] & (1 << (y & 7));
+}
+
 void MAX3000_Base::drawPixel(int16_t x, int16_t y, uint16_t color) {
-    if((x >= 0) && (x < localWidth) && (y >= 0) && (y < localHeight)) {
-        // Pixel is in-bounds. Rotate coordinates if needed.
-        switch(localRotation) {
-            case 1:
-                MAX3000_swap(x, y);
-                x = config.width - x - 1;
-                break;
-            case 2:
-                x = config.width - x - 1;
-                y = config.height - y - 1;
-                break;
-            case 3:
-                MAX3000_swap(x, y);
-                y = config.height - y - 1;
-                break;
-        }
-
-        switch(color) {
-            case MAX3000_LIGHT:
-                buffer[x + (y / 8) * config.width] |= (1 << (y & 7));
-                break;
-            case MAX3000_DARK:
-                buffer[x + (y / 8) * config.width] &= ~(1 << (y & 7));
-                break;
-            case MAX3000_INVERSE:
-                buffer[x + (y / 8) * config.width] ^= (1 << (y & 7));
-                break;
+    drawPixelFast(x, y, color);
+}
+
+void MAX3000_Base::fillScreen(uint16_t color) {
+    switch(color) {
+        case MAX3000_LIGHT:
+            memset(buffer, 0xFF, bufferSize);
+            break;
+        case MAX3000_DARK:
+            memset(buffer, 0, bufferSize);
+            break;
+        case MAX3000_INVERSE:
+            // bufferSize is always a multiple of 8, so this can go a word at a time
+            for(size_t i = 0; i < bufferSize; i += 4) {
+                *(uint32_t *)&buffer[i] ^= 0xFFFFFFFF;
+            }
+            break;
+    }
+    markDirtyBytes(0, bufferSize);
+}
+
+void MAX3000_Base::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    // Clip to the display
+    if(x < 0) {
+        w += x;
+        x = 0;
+    }
+    if(y < 0) {
+        h += y;
+        y = 0;
+    }
+    if(x + w > localWidth) {
+        w = localWidth - x;
+    }
+    if(y + h > localHeight) {
+        h = localHeight - y;
+    }
+    if((w <= 0) || (h <= 0)) {
+        return;
+    }
+
+    // Rotate the rectangle the same way drawPixel() rotates its corners
+    switch(localRotation) {
+        case 0:
+            fillBufferRect(x, y, w, h, color);
+            break;
+        case 1:
+            fillBufferRect(config.width - y - h, x, h, w, color);
+            break;
+        case 2:
+            fillBufferRect(config.width - x - w, config.height - y - h, w, h, color);
+            break;
+        case 3:
+            fillBufferRect(y, config.height - x - w, h, w, color);
+            break;
+    }
+}
+
+void MAX3000_Base::fillBufferRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for(int16_t page = y / 8; page <= (y + h - 1) / 8; ++page) {
+        // Rows of this page inside the rectangle
+        int16_t top    = (y > page * 8) ? y : page * 8;
+        int16_t bottom = (y + h < page * 8 + 8) ? y + h : page * 8 + 8;
+        uint8_t mask   = ((1 << (bottom - top)) - 1) << (top & 7);
+
+        size_t offset = x + page * config.width;
+        uint8_t *row  = &buffer[offset];
+        if((mask == 0xFF) && (color != MAX3000_INVERSE)) {
+            memset(row, (color == MAX3000_LIGHT) ? 0xFF : 0, w);
+        } else {
+            switch(color) {
+                case MAX3000_LIGHT:
+                    for(int16_t i = 0; i < w; ++i) {
+                        row[i] |= mask;
+                    }
+                    break;
+                case MAX3000_DARK:
+                    for(int16_t i = 0; i < w; ++i) {
+                        row[i] &= ~mask;
+                    }
+                    break;
+                case MAX3000_INVERSE:
+                    for(int16_t i = 0; i < w; ++i) {
+                        row[i] ^= mask;
+                    }
+                    break;
+            }
+        }
+        markDirtyBytes(offset, w);
+    }
+}
+
+void MAX3000_Base::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    fillRect(x, y, w, 1, color);
+}
+
+void MAX3000_Base::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    fillRect(x, y, 1, h, color);
+}
+
+void MAX3000_Base::drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color) {
+    int16_t byteWidth = (w + 7) / 8;
+    for(int16_t j = 0; j < h; ++j) {
+        const uint8_t *line = &bitmap[j * byteWidth];
+        int16_t i = 0;
+        while(i < w) {
+            // Skip clear bits, then draw the run of set bits that follows as one line
+            if(!(line[i / 8] & (0x80 >> (i & 7)))) {
+                ++i;
+                continue;
+            }
+            int16_t start = i;
+            while((i < w) && (line[i / 8] & (0x80 >> (i & 7)))) {
+                ++i;
+            }
+            drawFastHLine(x + start, y + j, i - start, color);
         }
     }
 }
 
 void MAX3000_Base::clearDisplay(void) {
-    memset(buffer, 0, BUFFER_SIZE);
+    memset(buffer, 0, bufferSize);
+    markDirtyBytes(0, bufferSize);
+}
+
+void MAX3000_Base::markDirtyBytes(size_t offset, size_t length) {
+    if(!trackDirty) {
+        return;
+    }
+    for(size_t i = offset; i < offset + length; ++i) {
+        if(buffer[i] != oldBuffer[i]) {
+            MARK_DIRTY(i)
+        }
+    }
+}
+
+uint32_t MAX3000_Base::diffWord(const uint8_t *frame, size_t offset, bool all) {
+    // Skip the compare when none of the four bytes were drawn since the last display()
+    if(!all && frame == buffer && ((dirtyBytes[offset >> 3] >> (offset & 7)) & 0x0F) == 0) {
+        return 0;
+    }
+    if(all) {
+        return 0xFFFFFFFF;
+    }
+
+    uint32_t newWord, oldWord;
+    memcpy(&newWord, frame + offset, sizeof(newWord));
+    memcpy(&oldWord, oldBuffer + offset, sizeof(oldWord));
+    return newWord ^ oldWord;
+}
+
+size_t MAX3000_Base::diffBuffer(const uint8_t *frame, bool force) {
+    bool all = force || firstUpdate;
+    size_t numChanges = 0;
+
+    uint8_t numRanks = (priorityEnabled || flipOrder == MAX3000_FLIP_OLDEST) ? 3 : 1;
+
+    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+        boardChanges[board] = numChanges;
+
+        // A board's 16 rows are two pages of the buffer, and its 28 columns are
+        // 28 consecutive bytes within each page. Compare four columns of both
+        // pages at a time, and only decode the words that differ. The ESP is
+        // little-endian, so byte c of each word is column c.
+        size_t loOffset = boardOffset[board];
+        size_t hiOffset = loOffset + config.width;
+
+        // Pixels to set come first and pixels to clear after them, so each
+        // pulse pass walks its own part of the list without skipping entries.
+        for(uint8_t pass = 0; pass < 2; ++pass) {
+            bool setPass  = (pass == 0);
+            if(!setPass) {
+                boardSplit[board] = numChanges;
+            }
+
+            // Each rank is listed in full before the next: priority regions, then dots
+            // carried over from an unfinished frame, then the rest
+            for(uint8_t rank = 0; rank < numRanks; ++rank) {
+                size_t first = numChanges;
+
+                for(size_t col = 0; col < PANEL_WIDTH; col += 4) {
+                    uint32_t loDiff = diffWord(frame, loOffset + col, all);
+                    uint32_t hiDiff = diffWord(frame, hiOffset + col, all);
+                    if((loDiff | hiDiff) == 0) {
+                        continue;
+                    }
+
+                    for(size_t c = 0; c < 4; ++c) {
+                        uint16_t colDiff = ((loDiff >> (c * 8)) & 0xFF) | (((hiDiff >> (c * 8)) & 0xFF) << 8);
+                        uint16_t colNew  = frame[loOffset + col + c] | (frame[hiOffset + col + c] << 8);
+
+                        // Keep the pixels this pass flips; inverted, a set pulse shows a dark pixel
+                        colDiff &= (setPass != invertEnabled) ? colNew : ~colNew;
+                        if(numRanks > 1) {
+                            colDiff &= rankMask(rank, loOffset + col + c, hiOffset + col + c);
+                        }
+                        while(colDiff) {
+                            uint8_t row = __builtin_ctz(colDiff);
+                            colDiff &= colDiff - 1;
+
+                            changes[numChanges].board = board;
+                            changes[numChanges].row   = row;
+                            changes[numChanges].col   = col + c;
+                            changes[numChanges].value = (colNew >> row) & 1;
+                            numChanges++;
+                        }
+                    }
+                }
+
+                // If dissolving, flip this board's changes in a random order
+                if(dissolveEnabled) {
+                    shuffleChanges(first, numChanges);
+                }
+            }
+        }
+    }
+    boardChanges[config.numHBoards * config.numVBoards] = numChanges;
+
+    return numChanges;
+}
+
+bool MAX3000_Base::refreshDirtyBytes(void) {
+    // Drop bytes that were touched but ended up back at their displayed value,
+    // e.g. cleared and then redrawn by the same frame.
+    bool anyDirty = false;
+    for(size_t i = 0; i < (bufferSize + 7) / 8; ++i) {
+        if(dirtyBytes[i] == 0) {
+            continue;
+        }
+        for(uint8_t bit = 0; bit < 8; ++bit) {
+            size_t offset = i * 8 + bit;
+            if((dirtyBytes[i] & (1 << bit)) && buffer[offset] == oldBuffer[offset]) {
+                dirtyBytes[i] &= ~(1 << bit);
+            }
+        }
+        if(dirtyBytes[i] != 0) {
+            anyDirty = true;
+        }
+    }
+    return anyDirty;
 }
 
 bool MAX3000_Base::getPixel(int16_t x, int16_t y) {
-    if((x >= 0) && (x < localWidth) && (y >= 0) && (y < localHeight)) {
-        // Pixel is in-bounds. Rotate coordinates if needed.
-        switch(localRotation) {
-            case 1:
-                MAX3000_swap(x, y);
-                x = config.width - x - 1;
-                break;
-            case 2:
-                x = config.width - x - 1;
-                y = config.height - y - 1;
-                break;
-            case 3:
-                MAX3000_swap(x, y);
-                y = config.height - y - 1;
-                break;
-        }
-        return buffer[x + (y / 8) * config.width] & (1 << (y & 7));
-    }
-    return false;    // Pixel out of bounds
+    return (this->*pixelReader)(x, y);
 }
 
 void MAX3000_Base::setUserLED(size_t board, bool state) {
@@ -210,107 +700,210 @@ void MAX3000_Base::setUserLED(size_t board, bool state) {
 }
 
 void MAX3000_Base::display(bool force) {
-    int numChanged = 0;
+    uint32_t startTime = micros();
 
-    for(int i = 0; i < PANEL_HEIGHT * PANEL_WIDTH; ++i) {
 #if defined(ESP8266)
-        if(i == 0) {
-            yield();
-        }
+    yield();
 #endif
 
-        // If dissolving, pick the shuffled index
-        int index = (dissolveEnabled) ? shuffledIndex[i] : i;
+    beginFrame(force);
+    while(pulseNext()) {
+        if(flipBudget && stats.dotFlips >= flipBudget) {
+            // The rest is left for displayStep() or the next frame
+            break;
+        }
+    }
 
-        size_t col = (index / PANEL_HEIGHT);
-        size_t row = (index % PANEL_HEIGHT);
+    if(constantRate) {
+        // Wait out the rest of the time a frame flipping every position would take
+        uint32_t frameUs = PANEL_HEIGHT * PANEL_WIDTH * estimatePulseTimeUs();
+        uint32_t spentUs = micros() - startTime;
+        while(spentUs < frameUs) {
+#if defined(ESP8266)
+            yield();
+#endif
+            uint32_t waitUs = (frameUs - spentUs > 1000) ? 1000 : frameUs - spentUs;
+            MAX3000_WAIT(waitUs)
+            spentUs = micros() - startTime;
+        }
+    }
 
-        bool pixelsToSet[config.numHBoards * config.numVBoards];
-        bool pixelsToClear[config.numHBoards * config.numVBoards];
-        memset(pixelsToSet, 0, config.numHBoards * config.numVBoards * sizeof(bool));
-        memset(pixelsToClear, 0, config.numHBoards * config.numVBoards * sizeof(bool));
+    stats.elapsedUs = micros() - startTime;
+}
 
-        // First pass: Get the set/clear
-        // Since all boards share the same pulse lines, we have to figure out the
-        // required operation for every board first.
-        // Thus we just store what we want to do in an array, and then actually load
-        // and pulse once we've checked every board.
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            size_t boardCol     = board % config.numHBoards;
-            size_t bufferOffset = (col + boardCol * PANEL_WIDTH) + ((row / 8) * config.numHBoards * PANEL_WIDTH);
+void MAX3000_Base::beginFrame(bool force) {
+    beginFrame(buffer, force);
+}
 
-            bool newPixVal = buffer[bufferOffset] & (1 << (row & 7));
-            bool oldPixVal = oldBuffer[bufferOffset] & (1 << (row & 7));
+void MAX3000_Base::beginFrame(const uint8_t *frame, bool force) {
+    memset(&stats, 0, sizeof(stats));
 
-            // Check if we can skip the update.
-            // If it's the first update, we need to refresh everything.
-            if(!force && !firstUpdate && newPixVal == oldPixVal) {
-                continue;
-            }
-
-            // Pre-select the decoder inputs for each board now.
-            selectRowColumn(board, row, col);
+    // A forced frame that was replaced before it finished still has to refresh
+    // the pixels it didn't get to, so keep forcing until one completes.
+    forcePending = forcePending || force;
 
-            bool setPixel        = (newPixVal != invertEnabled);
-            pixelsToSet[board]   = setPixel;
-            pixelsToClear[board] = !setPixel;
-            numChanged++;
-        }
+    // Pixels still pending from an unfinished frame were never stored to
+    // oldBuffer, so they stay dirty and are listed again here. Pixels that
+    // changed back before they were flipped drop out. Frames from outside
+    // the buffer have no dirty bits and are compared in full.
+    size_t numChanges = 0;
+    if(flipOrder == MAX3000_FLIP_OLDEST) {
+        markCarriedChanges();
+    }
+    if(forcePending || firstUpdate || frame != buffer || refreshDirtyBytes()) {
+        numChanges = diffBuffer(frame, forcePending);
+    }
 
-        // Second Pass: Turn on pixels that need to be set
-        // If no change is necessary for a board, neither row or column will
-        // be sourced and the pixel will remain in its existing state
-        bool setChanged = false;
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            // Setting -> Row Set Source, Column sink
-            LOAD_SR(board, SR_PIN_COL_SOURCE, 0);
-            LOAD_SR(board, SR_PIN_ROW_SOURCE, pixelsToSet[board]);
-            if(pixelsToSet[board]) setChanged = true;
+    // Every board has its own decoder inputs in the shift register chain, so the
+    // boards don't have to flip the same position at the same time. Each board
+    // keeps its own cursors into its part of the change list for pixels to set
+    // and pixels to clear, and every pulse flips the next pending pixel on every
+    // board. A frame takes as many pulses as the busiest board needs.
+    size_t numBoards = config.numHBoards * config.numVBoards;
+    memcpy(setCursor, boardChanges, numBoards * sizeof(size_t));
+    memcpy(clearCursor, boardSplit, numBoards * sizeof(size_t));
+
+    // One bit per board that still has pixels to set or clear, so a pulse
+    // only visits the boards that have work left.
+    memset(setPending, 0, ((numBoards + 31) / 32) * sizeof(uint32_t));
+    memset(clearPending, 0, ((numBoards + 31) / 32) * sizeof(uint32_t));
+    for(size_t board = 0; board < numBoards; ++board) {
+        if(setCursor[board] < boardSplit[board]) {
+            setPending[board / 32] |= (1UL << (board % 32));
         }
-        if(setChanged) {
-            shiftRegWrite();
-            setPixel();
+        if(clearCursor[board] < boardChanges[board + 1]) {
+            clearPending[board / 32] |= (1UL << (board % 32));
         }
+    }
+    frameActive = true;
 
-        // Second Pass: Turn off pixels that need to be cleared
-        // If no change is necessary for a board, neither row or column will
-        // be sourced and the pixel will remain in its existing state
-        bool resetChanged = false;
-        for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
-            // Setting -> Row Set Source, Column sink
-            LOAD_SR(board, SR_PIN_COL_SOURCE, pixelsToClear[board]);
-            LOAD_SR(board, SR_PIN_ROW_SOURCE, 0);
-            if(pixelsToClear[board]) resetChanged = true;
+    if(numChanges == 0) {
+        // Nothing can differ from what is on the panel, so there is nothing to pulse.
+        endFrame();
+    }
+}
+
+void MAX3000_Base::displayStep(uint32_t budgetUs) {
+    uint32_t startTime  = micros();
+    uint32_t startFlips = stats.dotFlips;
+
+    while(frameActive && pulseNext()) {
+        if((uint32_t)(micros() - startTime) >= budgetUs) {
+            break;
         }
-        if(resetChanged) {
-            shiftRegWrite();
-            clearPixel();
+        if(flipBudget && stats.dotFlips - startFlips >= flipBudget) {
+            break;
         }
     }
 
-    // Store current buffer to avoid unnecessary changes on next update.
-    memcpy(oldBuffer, buffer, BUFFER_SIZE);
-    firstUpdate = false;
+    stats.elapsedUs += micros() - startTime;
+}
 
-    if(constantRate) {
-        for(int i = numChanged; i < PANEL_HEIGHT * PANEL_WIDTH; ++i) {
-#if defined(ESP8266)
-            yield();
-#endif
-            shiftRegWrite();
-            delayMicroseconds(5);
-            delayMicroseconds(pulseDuration);
-            delayMicroseconds(5);
+bool MAX3000_Base::pulseNext() {
+    if(!frameActive) {
+        return false;
+    }
+
+    // First Pass: Turn on the next pixel that needs to be set on each board
+    // If no change is necessary for a board, neither row or column will
+    // be sourced and the pixel will remain in its existing state
+    // Setting -> Row Set Source, Column sink
+    uint16_t setUs = loadPass(setPending, setCursor, boardSplit, setPulseUs, (1 << SR_PIN_ROW_SOURCE));
+    bool setChanged = (setUs != 0);
+    if(setChanged) {
+        shiftRegWrite();
+        setPixel(setUs);
+        stats.pulses++;
+    }
+
+    // Second Pass: Turn off the next pixel that needs to be cleared on each board
+    // Clearing -> Column Source, Row sink
+    uint16_t clearUs = loadPass(clearPending, clearCursor, boardChanges + 1, clearPulseUs, (1 << SR_PIN_COL_SOURCE));
+    bool resetChanged = (clearUs != 0);
+    if(resetChanged) {
+        shiftRegWrite();
+        clearPixel(clearUs);
+        stats.pulses++;
+    }
+
+    if(!setChanged && !resetChanged) {
+        endFrame();
+        return false;
+    }
+    return true;
+}
+
+uint16_t MAX3000_Base::loadPass(uint32_t *pending, size_t *cursor, const size_t *end, const uint16_t *durations,
+    uint16_t source) {
+    size_t numBoards = config.numHBoards * config.numVBoards;
+
+    // Boards without a pixel in this pass source neither row nor column
+    for(size_t board = 0; board < numBoards; ++board) {
+        shiftReg[board] &= ~((1 << SR_PIN_ROW_SOURCE) | (1 << SR_PIN_COL_SOURCE));
+    }
+
+    // The pulse line is shared, so the pulse lasts as long as the slowest selected board needs
+    uint16_t pulseUs = 0;
+    for(size_t word = 0; word < (numBoards + 31) / 32; ++word) {
+        uint32_t boards = pending[word];
+        while(boards) {
+            size_t board = word * 32 + __builtin_ctz(boards);
+            boards &= boards - 1;
+
+            selectChange(board, changes[cursor[board]]);
+            shiftReg[board] |= source;
+            if(++cursor[board] == end[board]) {
+                pending[word] &= ~(1UL << (board % 32));
+            }
+            stats.dotFlips++;
+
+            // At least 1us, so that a selected board always reports a pulse
+            uint16_t boardUs = durations[board] ? durations[board] : 1;
+            pulseUs = (boardUs > pulseUs) ? boardUs : pulseUs;
         }
     }
+    return pulseUs;
+}
+
+void MAX3000_Base::endFrame() {
+    // Every changed pixel was stored to oldBuffer as it was flipped, and the
+    // dirty bits of those bytes are dropped by the next refreshDirtyBytes().
+    frameActive  = false;
+    forcePending = false;
+    firstUpdate  = false;
+}
+
+void MAX3000_Base::selectChange(size_t board, const MAX3000_Change & change) {
+    // Pre-select the decoder inputs for this board now, and record the
+    // new state of just this pixel as displayed.
+    selectRowColumn(board, change.row, change.col);
+
+    size_t bufferOffset = boardOffset[board] + change.col + ((change.row / 8) * config.width);
+    if(change.value) {
+        oldBuffer[bufferOffset] |= (1 << (change.row & 7));
+    } else {
+        oldBuffer[bufferOffset] &= ~(1 << (change.row & 7));
+    }
 }
 
 void MAX3000_Base::copyBuffer(uint8_t *toBuffer) {
-  memcpy(toBuffer, buffer, BUFFER_SIZE);
+  memcpy(toBuffer, buffer, bufferSize);
 }
 
 void MAX3000_Base::replaceBuffer(uint8_t *fromBuffer) {
-  memcpy(buffer, fromBuffer, BUFFER_SIZE);
+  memcpy(buffer, fromBuffer, bufferSize);
+  markDirtyBytes(0, bufferSize);
+}
+
+void MAX3000_Base::blendBuffer(const uint8_t *mask, const uint8_t *bits) {
+    // bufferSize is always a multiple of 8, so this can go a word at a time
+    for(size_t i = 0; i < bufferSize; i += 4) {
+        uint32_t m = *(const uint32_t *)&mask[i];
+        if(m) {
+            *(uint32_t *)&buffer[i] = (*(uint32_t *)&buffer[i] & ~m) | (*(const uint32_t *)&bits[i] & m);
+        }
+    }
+    markDirtyBytes(0, bufferSize);
 }
 
 void MAX3000_Base::invertDisplay(bool i) {
@@ -320,8 +913,123 @@ void MAX3000_Base::invertDisplay(bool i) {
     display(true);
 }
 
+void MAX3000_Base::copyWindow(const uint8_t *image, int32_t imageWidth, int32_t left) {
+    // Columns of the display the image covers
+    int32_t first = (left < 0) ? -left : 0;
+    int32_t last  = imageWidth - left;
+    if(last > config.width) {
+        last = config.width;
+    }
+    if(last < first) {
+        last = first = 0;
+    }
+
+    for(size_t page = 0; page < (size_t)(config.height + 7) / 8; ++page) {
+        uint8_t *row = &buffer[page * config.width];
+        memset(row, 0, first);
+        if(last > first) {
+            memcpy(row + first, &image[page * imageWidth + left + first], last - first);
+        }
+        memset(row + last, 0, config.width - last);
+    }
+    markDirtyBytes(0, bufferSize);
+}
+
+bool MAX3000_Base::applyFramePacket(const uint8_t *packet, size_t length) {
+    if(length < MAX3000_PACKET_HEADER) {
+        return false;
+    }
+    uint8_t type         = packet[0];
+    uint8_t sequence     = packet[1];
+    const uint8_t *data  = packet + MAX3000_PACKET_HEADER;
+    size_t dataLength    = length - MAX3000_PACKET_HEADER;
+
+    // A delta only makes sense on top of the frame it was made from
+    if(type != MAX3000_PACKET_FULL && !(framePacketValid && sequence == (uint8_t)(framePacketSequence + 1))) {
+        return false;
+    }
+
+    switch(type) {
+        case MAX3000_PACKET_FULL:
+            if(dataLength != bufferSize) {
+                return false;
+            }
+            memcpy(buffer, data, bufferSize);
+            markDirtyBytes(0, bufferSize);
+            break;
+
+        case MAX3000_PACKET_XOR:
+            if(dataLength != bufferSize) {
+                return false;
+            }
+            for(size_t i = 0; i < bufferSize; ++i) {
+                buffer[i] ^= data[i];
+            }
+            markDirtyBytes(0, bufferSize);
+            break;
+
+        case MAX3000_PACKET_XOR_RLE: {
+            // Check every run fits before touching the buffer
+            size_t offset = 0;
+            for(size_t i = 0; i < dataLength; ++i) {
+                size_t run = (data[i] & 0x7F) + 1;
+                if(data[i] & 0x80) {
+                    if(i + run >= dataLength) {
+                        return false;
+                    }
+                    i += run;
+                }
+                offset += run;
+                if(offset > bufferSize) {
+                    return false;
+                }
+            }
+
+            offset = 0;
+            for(size_t i = 0; i < dataLength; ++i) {
+                size_t run = (data[i] & 0x7F) + 1;
+                if(data[i] & 0x80) {
+                    for(size_t j = 0; j < run; ++j) {
+                        buffer[offset + j] ^= data[++i];
+                    }
+                    markDirtyBytes(offset, run);
+                }
+                offset += run;
+            }
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    framePacketSequence = sequence;
+    framePacketValid    = true;
+    return true;
+}
+
 void MAX3000_Base::setDisplayRotation(uint8_t x) {
+    // Pixel functions specialized for each rotation, indexed by color
+    static const PixelWriter writers[4][3] = {
+        { &MAX3000_Base::writePixel<0, MAX3000_DARK>, &MAX3000_Base::writePixel<0, MAX3000_LIGHT>,
+          &MAX3000_Base::writePixel<0, MAX3000_INVERSE> },
+        { &MAX3000_Base::writePixel<1, MAX3000_DARK>, &MAX3000_Base::writePixel<1, MAX3000_LIGHT>,
+          &MAX3000_Base::writePixel<1, MAX3000_INVERSE> },
+        { &MAX3000_Base::writePixel<2, MAX3000_DARK>, &MAX3000_Base::writePixel<2, MAX3000_LIGHT>,
+          &MAX3000_Base::writePixel<2, MAX3000_INVERSE> },
+        { &MAX3000_Base::writePixel<3, MAX3000_DARK>, &MAX3000_Base::writePixel<3, MAX3000_LIGHT>,
+          &MAX3000_Base::writePixel<3, MAX3000_INVERSE> },
+    };
+    static const PixelReader readers[4] = {
+        &MAX3000_Base::readPixel<0>,
+        &MAX3000_Base::readPixel<1>,
+        &MAX3000_Base::readPixel<2>,
+        &MAX3000_Base::readPixel<3>,
+    };
+
     localRotation = (x & 3);
+    memcpy(pixelWriters, writers[localRotation], sizeof(pixelWriters));
+    pixelReader = readers[localRotation];
     switch(localRotation) {
         case 0:
         case 2:
@@ -340,88 +1048,332 @@ void MAX3000_Base::setDissolveEnable(bool param) {
     dissolveEnabled = param;
 }
 
+uint32_t MAX3000_Base::estimatePulseTimeUs(void) const {
+    // Loading the longest chain at the bit-bang clock rate, then the pulse
+    // itself with its two 5us edges.
+    uint32_t shiftUs = 0;
+    if((config.spi == NULL) && config.shiftClockHz) {
+        shiftUs = longestChain * 16 * 1000000UL / config.shiftClockHz;
+    }
+
+    // Boards given longer pulses of their own hold up every pulse they take part in
+    uint32_t pulseUs = pulseDuration;
+    if(setPulseUs != NULL) {
+        for(size_t board = 0; board < config.numVBoards * config.numHBoards; ++board) {
+            if(setPulseUs[board] > pulseUs) {
+                pulseUs = setPulseUs[board];
+            }
+            if(clearPulseUs[board] > pulseUs) {
+                pulseUs = clearPulseUs[board];
+            }
+        }
+    }
+    return shiftUs + pulseUs + 10;
+}
+
 void MAX3000_Base::setPulseDurationUs(uint16_t param) {
     pulseDuration = param;
+    if(setPulseUs != NULL) {
+        for(size_t board = 0; board < config.numVBoards * config.numHBoards; ++board) {
+            setPulseUs[board]   = param;
+            clearPulseUs[board] = param;
+        }
+    }
+}
+
+void MAX3000_Base::setBoardPulseDurationUs(size_t board, uint16_t setUs, uint16_t clearUs) {
+    if((setPulseUs == NULL) || (board >= config.numVBoards * config.numHBoards)) {
+        return;
+    }
+    setPulseUs[board]   = setUs;
+    clearPulseUs[board] = clearUs;
+}
+
+void MAX3000_Base::setDirtyTracking(bool param) {
+    trackDirty = param;
 }
 
 void MAX3000_Base::setConstantFrameRate(bool param) {
     constantRate = param;
 }
 
-void MAX3000_Base::selectRowColumn(size_t board, size_t row, size_t column) {    // TODO Board Order
-    // Map sequential rows and columns to the hardware pins
-    const uint8_t colToCode[] = { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12,
-        15, 14, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27 };
-    const uint8_t rowToCode[] = { 14, 1, 15, 0, 12, 3, 13, 2, 10, 5, 11, 4, 8, 7, 9, 6 };
-
-    // Hack - Rows are reversed on the panel
-    row = 15 - row;
+void MAX3000_Base::selectRowColumn(size_t board, size_t row, size_t column) {
+    // A board mounted upside down has its first row and column where the last ones should be
+    size_t position = row * PANEL_WIDTH + column;
+    if(boardRotation[board] == 2) {
+        position = (PANEL_HEIGHT * PANEL_WIDTH - 1) - position;
+    }
+    shiftReg[board] = (shiftReg[board] & ~SR_DECODER_MASK) | decoderWords[position];
+}
 
-    uint8_t rowSubCode = rowToCode[row] % 8;
-    uint8_t rowBank    = rowToCode[row] / 8;
+void MAX3000_Base::getBoardPosition(size_t board, int16_t & x, int16_t & y) const {
+    size_t col, row;
+    switch(config.boardOrder) {
+        case MAX3000_ORDER_ROW_MAJOR_BOUNCE:
+            row = board / config.numHBoards;
+            col = board % config.numHBoards;
+            if(row & 1) {
+                col = config.numHBoards - 1 - col;
+            }
+            break;
+        case MAX3000_ORDER_COL_MAJOR:
+            col = board / config.numVBoards;
+            row = board % config.numVBoards;
+            break;
+        case MAX3000_ORDER_COL_MAJOR_BOUNCE:
+            col = board / config.numVBoards;
+            row = board % config.numVBoards;
+            if(col & 1) {
+                row = config.numVBoards - 1 - row;
+            }
+            break;
+        case MAX3000_ORDER_ROW_MAJOR:
+        default:
+            row = board / config.numHBoards;
+            col = board % config.numHBoards;
+            break;
+    }
+    x = col * PANEL_WIDTH;
+    y = row * PANEL_HEIGHT;
+}
 
-    uint8_t colSubCode = colToCode[column] % 8;
-    uint8_t colBank    = colToCode[column] / 8;
+void MAX3000_Base::setBoardRotation(size_t board, uint8_t r) {
+    if((boardRotation == NULL) || (board >= config.numHBoards * config.numVBoards)) {
+        return;
+    }
+    // Panels aren't square, so they can only be turned half way round
+    boardRotation[board] = r & 2;
 
-    LOAD_SR(board, SR_PIN_COL_A2, colSubCode & 0x4);
-    LOAD_SR(board, SR_PIN_COL_A1, colSubCode & 0x2);
-    LOAD_SR(board, SR_PIN_COL_A0, colSubCode & 0x1);
-    LOAD_SR(board, SR_PIN_ROW_A2, rowSubCode & 0x4);
-    LOAD_SR(board, SR_PIN_ROW_A1, rowSubCode & 0x2);
-    LOAD_SR(board, SR_PIN_ROW_A0, rowSubCode & 0x1);
-    LOAD_SR(board, SR_PIN_ROW_BANK, rowBank & 0x1);
-    LOAD_SR(board, SR_PIN_COL_BANK1, colBank & 0x2);
-    LOAD_SR(board, SR_PIN_COL_BANK0, colBank & 0x1);
+    // Everything on the board has to be flipped again where it now belongs
+    forcePending = true;
 }
 
-void MAX3000_Base::setPixel() {
+void MAX3000_Base::setPixel(uint16_t durationUs) {
     // Global Pulse Enable
     MAX3000_PULSE
 
     // Turn on Source first, then Sink
     MAX3000_PULSE_ROW
-    delayMicroseconds(5);
+    MAX3000_WAIT(5)
     MAX3000_PULSE_COL
 
     // Wait for Pulse Duration
-    delayMicroseconds(pulseDuration);
+    MAX3000_WAIT(durationUs)
 
     // Turn off Sink first, then Source
     MAX3000_UNPULSE_COL
-    delayMicroseconds(5);
+    MAX3000_WAIT(5)
     MAX3000_UNPULSE_ROW
 
     // Global Pulse Disable
     MAX3000_UNPULSE
 }
 
-void MAX3000_Base::clearPixel() {
+void MAX3000_Base::clearPixel(uint16_t durationUs) {
     // Global Pulse Enable
     MAX3000_PULSE
 
     // Turn on Source first, then Sink
     MAX3000_PULSE_COL
-    delayMicroseconds(5);
+    MAX3000_WAIT(5)
     MAX3000_PULSE_ROW
 
     // Wait for Pulse Duration
-    delayMicroseconds(pulseDuration);
+    MAX3000_WAIT(durationUs)
 
     // Turn off Sink first, then Source
     MAX3000_UNPULSE_ROW
-    delayMicroseconds(5);
+    MAX3000_WAIT(5)
     MAX3000_UNPULSE_COL
 
     // Global Pulse Disable
     MAX3000_UNPULSE
 }
 
-void MAX3000_Base::shuffleIndex() {
-    for(int i = 0; i < (int)(PANEL_HEIGHT * PANEL_WIDTH); i++) {
-        int n            = rand() % (PANEL_HEIGHT * PANEL_WIDTH);
-        int temp         = shuffledIndex[n];
-        shuffledIndex[n] = shuffledIndex[i];
-        shuffledIndex[i] = temp;
+bool MAX3000_FrameHandoff::begin(size_t size) {
+    for(uint8_t i = 0; i < 3; ++i) {
+        buffers[i] = new uint8_t[size];
+        memset(buffers[i], 0, size);
+    }
+    writeIndex = 0;
+    readIndex  = 1;
+    middle.store(2);
+    return true;
+}
+
+void MAX3000_FrameHandoff::publish() {
+    // Hand the finished buffer over and take back whichever one was waiting
+    writeIndex = middle.exchange(writeIndex | FRAME_FRESH, std::memory_order_acq_rel) & FRAME_INDEX;
+}
+
+const uint8_t *MAX3000_FrameHandoff::acquire() {
+    if(!(middle.load(std::memory_order_acquire) & FRAME_FRESH)) {
+        return NULL;
+    }
+    readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & FRAME_INDEX;
+    return buffers[readIndex];
+}
+
+bool MAX3000_DrawBatch::begin(MAX3000_Base *target_, int16_t width_, int16_t height_, size_t capacity_) {
+    target   = target_;
+    width    = width_;
+    height   = height_;
+    capacity = capacity_;
+    ops      = new MAX3000_DrawOp[capacity];
+    covered  = new uint8_t[width * ((height + 7) / 8)];
+    bits     = new uint8_t[width * ((height + 7) / 8)];
+    reset();
+    return true;
+}
+
+void MAX3000_DrawBatch::reset() {
+    count = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void MAX3000_DrawBatch::addRect(int16_t x, int16_t y, int16_t w, int16_t h, bool on) {
+    // Clip to the buffer
+    if(x < 0) {
+        w += x;
+        x = 0;
+    }
+    if(y < 0) {
+        h += y;
+        y = 0;
+    }
+    if(x + w > width) {
+        w = width - x;
+    }
+    if(y + h > height) {
+        h = height - y;
+    }
+    if((w <= 0) || (h <= 0)) {
+        return;
+    }
+
+    // Grow the previous operation when this one continues it in the same color
+    if(count > 0) {
+        MAX3000_DrawOp & last = ops[count - 1];
+        if((last.on == on) && (h == 1) && (last.h == 1) && (last.y == y) && (last.x + last.w == x)) {
+            last.w += w;
+            return;
+        }
+        if((last.on == on) && (w == 1) && (last.w == 1) && (last.x == x) && (last.y + last.h == y)) {
+            last.h += h;
+            return;
+        }
+    }
+
+    if(count == capacity) {
+        commit();
+    }
+    ops[count].x  = x;
+    ops[count].y  = y;
+    ops[count].w  = w;
+    ops[count].h  = h;
+    ops[count].on = on;
+    count++;
+    stats.ops++;
+}
+
+void MAX3000_DrawBatch::commit() {
+    if(count == 0) {
+        return;
+    }
+    uint32_t startTime = micros();
+
+    // Last operation first, so each pixel takes the color it was drawn with last
+    memset(covered, 0, width * ((height + 7) / 8));
+    for(size_t i = count; i-- > 0;) {
+        rasterize(ops[i]);
+    }
+    target->blendBuffer(covered, bits);
+    count = 0;
+
+    stats.rasterizeUs += micros() - startTime;
+}
+
+void MAX3000_DrawBatch::rasterize(const MAX3000_DrawOp & op) {
+    for(int16_t page = op.y / 8; page <= (op.y + op.h - 1) / 8; ++page) {
+        // Rows of this page inside the operation
+        int16_t top    = (op.y > page * 8) ? op.y : page * 8;
+        int16_t bottom = (op.y + op.h < page * 8 + 8) ? op.y + op.h : page * 8 + 8;
+        uint8_t mask   = ((1 << (bottom - top)) - 1) << (top & 7);
+
+        size_t offset = op.x + page * width;
+        for(int16_t i = 0; i < op.w; ++i) {
+            uint8_t fresh = mask & ~covered[offset + i];
+            covered[offset + i] |= fresh;
+            if(op.on) {
+                bits[offset + i] |= fresh;
+            } else {
+                bits[offset + i] &= ~fresh;
+            }
+            stats.pixelsWritten += __builtin_popcount(fresh);
+        }
+        stats.pixelsDrawn += __builtin_popcount(mask) * op.w;
+    }
+}
+
+uint16_t MAX3000_Base::rankMask(uint8_t rank, size_t loOffset, size_t hiOffset) const {
+    uint16_t priority = priorityEnabled ? (priorityMask[loOffset] | (priorityMask[hiOffset] << 8)) : 0;
+    uint16_t carried  = (flipOrder == MAX3000_FLIP_OLDEST) ? (carriedMask[loOffset] | (carriedMask[hiOffset] << 8)) : 0;
+    if(rank == 0) {
+        return priority;
+    }
+    return (rank == 1) ? (~priority & carried) : (~priority & ~carried);
+}
+
+void MAX3000_Base::markCarriedChanges(void) {
+    // Only the dots still waiting in the change list count, so a dot carried
+    // over and then flipped or changed back drops out again.
+    memset(carriedMask, 0, bufferSize);
+    if(!frameActive) {
+        return;
+    }
+    for(size_t board = 0; board < config.numHBoards * config.numVBoards; ++board) {
+        for(int pass = 0; pass < 2; ++pass) {
+            size_t i   = pass ? clearCursor[board] : setCursor[board];
+            size_t end = pass ? boardChanges[board + 1] : boardSplit[board];
+            for(; i < end; ++i) {
+                const MAX3000_Change & change = changes[i];
+                carriedMask[boardOffset[board] + change.col + (change.row / 8) * config.width] |= 1 << (change.row & 7);
+            }
+        }
+    }
+}
+
+void MAX3000_Base::setPriorityRect(int16_t x, int16_t y, int16_t w, int16_t h, bool set) {
+    for(int16_t i = (x < 0) ? 0 : x; i < x + w && i < config.width; ++i) {
+        for(int16_t j = (y < 0) ? 0 : y; j < y + h && j < config.height; ++j) {
+            if(set) {
+                priorityMask[i + (j / 8) * config.width] |= 1 << (j & 7);
+            } else {
+                priorityMask[i + (j / 8) * config.width] &= ~(1 << (j & 7));
+            }
+        }
+    }
+
+    priorityEnabled = false;
+    for(size_t i = 0; i < bufferSize; ++i) {
+        if(priorityMask[i]) {
+            priorityEnabled = true;
+            break;
+        }
+    }
+}
+
+void MAX3000_Base::clearPriorityRects(void) {
+    memset(priorityMask, 0, bufferSize);
+    priorityEnabled = false;
+}
+
+void MAX3000_Base::shuffleChanges(size_t first, size_t last) {
+    for(size_t i = first; i < last; i++) {
+        size_t n         = first + rand() % (last - first);
+        MAX3000_Change temp = changes[n];
+        changes[n]       = changes[i];
+        changes[i]       = temp;
     }
 }
 
@@ -2,6 +2,8 @@
 #include "esphome/core/log.h"
 #include "esphome/core/helpers.h"
 
+#include <atomic>
+
 namespace esphome {
 namespace max3000 {
 
@@ -42,10 +44,112 @@ namespace max3000 {
 #define MAX3000_ORDER_COL_MAJOR 2           // Boards wired in columns
 #define MAX3000_ORDER_COL_MAJOR_BOUNCE 3    // Boards wired in columns, moving backwards on every other column
 
+// Default bit rate for bit-banging the shift registers. ESP boards toggle pins much
+// faster than the driver was designed for, so they get slowed down to about 3us per edge.
+#if defined(ESP32) || defined(ESP8266) || defined(ARDUINO_ARCH_STM32)
+#define MAX3000_DEFAULT_SHIFT_CLOCK 111111
+#else
+#define MAX3000_DEFAULT_SHIFT_CLOCK 0    // As fast as the pins go
+#endif
+
 #define PANEL_WIDTH 28     // Fixed number of columns in each MAX3000 panel
 #define PANEL_HEIGHT 16    // Fixed number of rows in each MAX3000 panel
 
-#define BUFFER_SIZE config.width *((config.height + 7) / 8)
+#define MAX3000_FLIP_SPATIAL 0    // Flip the pending dots of each board column by column
+#define MAX3000_FLIP_OLDEST 1     // Flip dots left over from unfinished frames before newer ones
+
+#define MAX3000_PACKET_FULL 0x01       // Frame packet holding a whole frame
+#define MAX3000_PACKET_XOR 0x02        // Frame packet holding a whole frame XORed with the previous one
+#define MAX3000_PACKET_XOR_RLE 0x03    // Frame packet holding the XOR with the previous frame as runs
+#define MAX3000_PACKET_HEADER 2        // Type and sequence number at the start of every frame packet
+
+#define MAX3000_MAX_CHAINS 4    // Most extra shift register chains driven alongside the main one
+
+
+/**
+ * @brief Interface to a hardware SPI peripheral used to load the driver shift registers.
+ *
+ * When one is supplied in \ref MAX3000_Config, the whole shift register chain is
+ * sent in a single transfer instead of being bit-banged through MOSI and CLK.
+ */
+class MAX3000_SPI {
+  public:
+    /**
+     * @brief Virtual Destructor
+     */
+    virtual ~MAX3000_SPI(void) {}
+
+    /**
+     * @brief Prepare the peripheral for use. Called from MAX3000_Base::begin().
+     */
+    virtual void begin(void) = 0;
+
+    /**
+     * @brief Send a buffer out on MOSI, most significant bit of each byte first.
+     *
+     * @param data Bytes to send, in chain order.
+     * @param length Number of bytes to send.
+     */
+    virtual void transfer(const uint8_t *data, size_t length) = 0;
+};
+
+/**
+ * @brief Counters describing the work done by the most recent call to display().
+ *
+ * modelUs adds up every wait the driver asks for (bit-bang delays and pulse
+ * timing), so it is the frame time on ideal hardware. elapsedUs is what
+ * display() actually took, including GPIO and CPU overhead.
+ */
+struct MAX3000_Stats {
+    uint32_t gpioWrites;     // Number of GPIO pin writes
+    uint32_t shiftPushes;    // Number of times the shift register chain was loaded and latched
+    uint32_t skippedPushes;  // Number of loads skipped because the chain already held the same image
+    uint32_t pulses;         // Number of set or clear pulses sent to the boards
+    uint32_t dotFlips;       // Number of individual dots flipped, summed over all boards
+    uint32_t modelUs;        // Sum of the delays requested while driving the display
+    uint32_t elapsedUs;      // Measured duration of display()
+};
+
+/**
+ * @brief Set and clear registers of a GPIO pin, for writing it without going through GPIOPin.
+ */
+struct MAX3000_FastPin {
+    volatile uint32_t *setReg;      // Writing mask here drives the pin high
+    volatile uint32_t *clearReg;    // Writing mask here drives the pin low
+    uint32_t mask;                  // Bit of the pin in both registers
+};
+
+/**
+ * @brief An extra chain of boards, shifted and pulsed in step with the main chain.
+ *
+ * Lines left NULL are shared with the main chain.
+ */
+struct MAX3000_Chain {
+    size_t numBoards;      // Number of boards on this chain
+    GPIOPin *mosi_pin;     // Pin connected to MTX_DIN of the first board on this chain
+    GPIOPin *sclk_pin;     // Pin connected to MTX_CLK, or NULL to share the main clock
+    GPIOPin *lat_pin;      // Pin connected to MTX_LAT, or NULL to share the main latch
+    GPIOPin *pulse_pin;    // Pin connected to PULSE_ENABLE, or NULL to share the main one
+    GPIOPin *col_pin;      // Pin connected to COL_ENABLE_N, or NULL to share the main one
+    GPIOPin *row_pin;      // Pin connected to ROW_ENABLE_N, or NULL to share the main one
+};
+
+/**
+ * @brief Set and clear registers of the pins of an extra chain.
+ */
+struct MAX3000_ChainFastPins {
+    MAX3000_FastPin fastMosi, fastSclk, fastLat, fastPulse, fastCol, fastRow;
+};
+
+/**
+ * @brief A single pixel that differs between the buffer and what is displayed.
+ */
+struct MAX3000_Change {
+    uint16_t board;    // Board Index, starting from 0
+    uint8_t row;       // Row index within the panel
+    uint8_t col;       // Column index within the panel
+    bool value;        // New value of the pixel
+};
 
 /**
  * @brief Configuration object for the MAX3000 library
@@ -60,17 +164,21 @@ class MAX3000_Config {
      * @param width_ If specified, sets the total width of the entire display in pixels.
      * @param height_ If specified, sets the total height of the entire display in pixels.
      */
-    MAX3000_Config(uint8_t width_ = 0, uint8_t height_ = 0)
+    MAX3000_Config(uint16_t width_ = 0, uint16_t height_ = 0)
         : width(((width_ + (PANEL_WIDTH - 1)) / PANEL_WIDTH) * PANEL_WIDTH),
           height(((height_ + (PANEL_HEIGHT - 1)) / PANEL_HEIGHT) * PANEL_HEIGHT),
           boardOrder(MAX3000_ORDER_ROW_MAJOR),
+          fastGpio(false),
+          shiftClockHz(MAX3000_DEFAULT_SHIFT_CLOCK),
+          spi(NULL),
           mosi_pin(NULL),
           sclk_pin(NULL),
           lat_pin(NULL),
           rst_pin(NULL),
           pulse_pin(NULL),
           col_pin(NULL),
-          row_pin(NULL) {
+          row_pin(NULL),
+          numChains(0) {
         numHBoards = width / PANEL_WIDTH;
         numVBoards = height / PANEL_HEIGHT;
     }
@@ -91,7 +199,7 @@ class MAX3000_Config {
      * @param col_pin_ Pin number connected to the COL_ENABLE_N pin on the driver.
      * @param row_pin_ Pin number connected to the ROW_ENABLE_N pin on the driver.
      */
-    MAX3000_Config(uint8_t width_, uint8_t height_,
+    MAX3000_Config(uint16_t width_, uint16_t height_,
         GPIOPin *mosi_pin_, GPIOPin *sclk_pin_, GPIOPin *lat_pin_, GPIOPin *rst_pin_, GPIOPin *pulse_pin_, GPIOPin *col_pin_, GPIOPin *row_pin_)
         : MAX3000_Config(width_, height_) {
         mosi_pin  = mosi_pin_;
@@ -103,9 +211,37 @@ class MAX3000_Config {
         row_pin   = row_pin_;
     }
 
-    uint8_t width;     // Total width of the combined display.
-    uint8_t height;    // Total height of the combined display.
+    /**
+     * @brief Configuration object using a hardware SPI peripheral.
+     *
+     * The width and height parameters are in pixels, and allow for chaining multiple boards.
+     *
+     * @param width_ If specified, sets the total width of the entire display in pixels.
+     * @param height_ If specified, sets the total height of the entire display in pixels.
+     * @param spi_ Hardware SPI peripheral wired to the MTX_DIN and MTX_CLK pins on the driver.
+     * @param lat_pin_ Pin number connected to the MTX_LAT latch pin on the driver.
+     * @param rst_pin_ Pin number connected to the MTX_RST reset pin on the driver.
+     * @param pulse_pin_ Pin number connected to the PULSE_ENABLE pin on the driver.
+     * @param col_pin_ Pin number connected to the COL_ENABLE_N pin on the driver.
+     * @param row_pin_ Pin number connected to the ROW_ENABLE_N pin on the driver.
+     */
+    MAX3000_Config(uint16_t width_, uint16_t height_,
+        MAX3000_SPI *spi_, GPIOPin *lat_pin_, GPIOPin *rst_pin_, GPIOPin *pulse_pin_, GPIOPin *col_pin_, GPIOPin *row_pin_)
+        : MAX3000_Config(width_, height_) {
+        spi       = spi_;
+        lat_pin   = lat_pin_;
+        rst_pin   = rst_pin_;
+        pulse_pin = pulse_pin_;
+        col_pin   = col_pin_;
+        row_pin   = row_pin_;
+    }
+
+    uint16_t width;     // Total width of the combined display.
+    uint16_t height;    // Total height of the combined display.
     uint8_t boardOrder;      // Ordering of boards within the data chain.
+    bool fastGpio;           // Write pins through their GPIO set/clear registers where supported
+    uint32_t shiftClockHz;   // Bit rate when bit-banging the shift registers, or 0 for no delays
+    MAX3000_SPI *spi{nullptr};          // Hardware SPI peripheral, or NULL to bit-bang MOSI/CLK
     GPIOPin *mosi_pin{nullptr};         // Pin connected to MTX_DIN
     GPIOPin *sclk_pin{nullptr};         // Pin connected to MTX_CLK
     GPIOPin *lat_pin{nullptr};          // Pin connected to MTX_LAT
@@ -114,6 +250,28 @@ class MAX3000_Config {
     GPIOPin *col_pin{nullptr};          // Pin connected to COL_ENABLE_N
     GPIOPin *row_pin{nullptr};          // Pin connected to ROW_ENABLE_N
 
+    /**
+     * @brief Adds a chain of boards that is shifted alongside the main one.
+     *
+     * Boards on the main chain come first in the board order, followed by the boards of
+     * each extra chain in the order they were added. The main chain drives every board
+     * not claimed by an extra chain. Extra chains are bit-banged, so they can't be used
+     * with hardware SPI.
+     *
+     * @param chain Pins and number of boards of the chain.
+     * @return False if MAX3000_MAX_CHAINS chains have already been added.
+     */
+    bool addChain(const MAX3000_Chain & chain) {
+        if(numChains >= MAX3000_MAX_CHAINS) {
+            return false;
+        }
+        chains[numChains++] = chain;
+        return true;
+    }
+
+    MAX3000_Chain chains[MAX3000_MAX_CHAINS];    // Extra chains, see addChain()
+    uint8_t numChains;                           // Number of extra chains in use
+
     // Computed in constructor:
     size_t numHBoards;    // Number of horizontal boards in the total display matrix
     size_t numVBoards;    // Number of vertical boards in the total display matrix
@@ -162,6 +320,81 @@ class MAX3000_Base {
      */
     void display(bool force = false);
 
+    /**
+     * @brief Starts sending the buffer to the display without blocking.
+     *
+     * Computes the pixels that have changed, then returns. The pulses are sent
+     * by later calls to displayStep(). Drawing may continue in the meantime;
+     * call beginFrame() again to pick up the new buffer contents, which keeps
+     * every pixel already flipped and drops pending pixels that changed back.
+     *
+     * @param force When true, sends a pulse for every pixel, instead of only
+     *              pixels that have changed.
+     */
+    void beginFrame(bool force = false);
+
+    /**
+     * @brief Starts sending a frame held outside the buffer without blocking.
+     *
+     * Same as beginFrame(bool), but the pixels come from frame, which must be
+     * laid out like the buffer and must not change until the next beginFrame().
+     *
+     * @param frame Pixels to display.
+     * @param force When true, sends a pulse for every pixel, instead of only
+     *              pixels that have changed.
+     */
+    void beginFrame(const uint8_t *frame, bool force = false);
+
+    /**
+     * @brief Sends pulses for the frame started by beginFrame().
+     *
+     * Returns once the frame is complete, or once budgetUs has passed. Since a
+     * set and clear pulse are sent together, it may overrun by one pair.
+     *
+     * @param budgetUs Time to spend sending pulses, in microseconds.
+     */
+    void displayStep(uint32_t budgetUs);
+
+    /**
+     * @brief Whether a frame started by beginFrame() still has pixels to flip.
+     */
+    bool displayPending(void) const { return frameActive; }
+
+    /**
+     * @brief Caps the dots flipped by each call to display() or displayStep().
+     *
+     * Dots over the budget stay pending: displayStep() carries on with them, and
+     * beginFrame() merges them into the next frame, dropping any that changed back.
+     * The budget is checked between pulses, so a call may go over it by the dots of
+     * one set and clear pulse.
+     *
+     * @param flips Most dots to flip per call, or 0 for no limit.
+     */
+    void setFlipBudget(uint32_t flips) { flipBudget = flips; }
+
+    /**
+     * @brief Sets which pending dots of each board are flipped first.
+     *
+     * Dots in a priority region always come first, see setPriorityRect().
+     *
+     * @param order One of the MAX3000_FLIP_* values.
+     */
+    void setFlipOrder(uint8_t order) { flipOrder = order; }
+
+    /**
+     * @brief Adds or removes a priority region, whose dots are flipped before any others.
+     *
+     * Coordinates are in the buffer, before display rotation. Call after begin().
+     *
+     * @param set True to add the rectangle to the priority regions, false to remove it.
+     */
+    void setPriorityRect(int16_t x, int16_t y, int16_t w, int16_t h, bool set = true);
+
+    /**
+     * @brief Removes every priority region.
+     */
+    void clearPriorityRects(void);
+
 
     /**
      * @brief Clear contents of display buffer (set all pixels to off).
@@ -180,6 +413,25 @@ class MAX3000_Base {
      */
     void setUserLED(size_t board, bool state);
 
+    /**
+     * @brief Gets where a board of the chain sits on the display, following config.boardOrder.
+     *
+     * @param board Board Index in the chain, starting from 0
+     * @param x Receives the column of the board's left edge.
+     * @param y Receives the row of the board's top edge.
+     */
+    void getBoardPosition(size_t board, int16_t & x, int16_t & y) const;
+
+    /**
+     * @brief Sets the rotation of a single board, for boards mounted upside down.
+     *
+     * Call after begin(). The next frame flips every pixel again.
+     *
+     * @param board Board Index in the chain, starting from 0
+     * @param r 0 for upright or 2 for upside down. Odd values are rounded down.
+     */
+    void setBoardRotation(size_t board, uint8_t r);
+
     /**
      * @brief Return color of a single pixel in display buffer.
      *
@@ -225,6 +477,106 @@ class MAX3000_Base {
      */
     virtual void drawPixel(int16_t x, int16_t y, uint16_t color);
 
+    /**
+     * @brief Same as drawPixel(), but without the virtual call.
+     *
+     * Goes straight to the pixel writer specialized for the current
+     * rotation and the given color.
+     *
+     * @param x Column of display -- 0 at left to (screen width - 1) at right.
+     * @param y Row of display -- 0 at top to (screen height -1) at bottom.
+     * @param color Line color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    inline void drawPixelFast(int16_t x, int16_t y, uint16_t color) {
+        if(color <= MAX3000_INVERSE) {
+            (this->*pixelWriters[color])(x, y);
+        }
+    }
+
+    /**
+     * @brief Sets one pixel at rotation 0, whatever the display rotation is.
+     *
+     * For callers that apply their own rotation, like ESPHome. Inlined, so a pixel costs a
+     * bounds check and a byte write instead of a call through the pixel writer table.
+     *
+     * @param x Column of the buffer -- 0 at left to (width - 1) at right.
+     * @param y Row of the buffer -- 0 at top to (height - 1) at bottom.
+     */
+    inline void setPixelRot0(int16_t x, int16_t y) {
+        writePixelRot0(x, y, true);
+    }
+
+    /**
+     * @brief Clears one pixel at rotation 0, whatever the display rotation is.
+     *
+     * @param x Column of the buffer -- 0 at left to (width - 1) at right.
+     * @param y Row of the buffer -- 0 at top to (height - 1) at bottom.
+     */
+    inline void clearPixelRot0(int16_t x, int16_t y) {
+        writePixelRot0(x, y, false);
+    }
+
+    /**
+     * @brief Set/clear/invert every pixel of the display.
+     *
+     * Changes buffer contents only, no immediate effect on display.
+     *
+     * @param color Fill color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    virtual void fillScreen(uint16_t color);
+
+    /**
+     * @brief Set/clear/invert a filled rectangle.
+     *
+     * Works on whole buffer bytes, one per column of each 8 row page,
+     * instead of pixel by pixel. Parts outside the display are clipped.
+     *
+     * @param x Left column of the rectangle.
+     * @param y Top row of the rectangle.
+     * @param w Width of the rectangle in pixels.
+     * @param h Height of the rectangle in pixels.
+     * @param color Fill color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+    /**
+     * @brief Set/clear/invert a horizontal line.
+     *
+     * @param x Left column of the line.
+     * @param y Row of the line.
+     * @param w Length of the line in pixels.
+     * @param color Line color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+
+    /**
+     * @brief Set/clear/invert a vertical line.
+     *
+     * Without rotation this is one masked byte per 8 rows.
+     *
+     * @param x Column of the line.
+     * @param y Top row of the line.
+     * @param h Length of the line in pixels.
+     * @param color Line color, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+
+    /**
+     * @brief Draws the set bits of a bitmap, leaving the others untouched.
+     *
+     * The bitmap uses the Adafruit_GFX layout: rows from top to bottom, each
+     * padded to a whole byte, with the leftmost pixel in the most significant
+     * bit. Each run of set bits in a row is drawn as one horizontal line.
+     *
+     * @param x Left column of the bitmap.
+     * @param y Top row of the bitmap.
+     * @param bitmap Bitmap data.
+     * @param w Width of the bitmap in pixels.
+     * @param h Height of the bitmap in pixels.
+     * @param color Color of the set bits, one of: MAX3000_LIGHT, MAX3000_DARK, or MAX3000_INVERSE.
+     */
+    virtual void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
+
     /**
      * @brief Sets whether updates should be random or sequential
      *
@@ -244,25 +596,109 @@ class MAX3000_Base {
      */
     void setPulseDurationUs(uint16_t duration);
 
+    /**
+     * @brief Sets the duration of the set and clear pulses of one board.
+     *
+     * All boards share the pulse line, so each pulse lasts as long as the
+     * slowest board flipping a dot in it needs. Call after begin().
+     *
+     * @param board Board Index, starting from 0
+     * @param setUs Duration of a pulse turning dots on, in microseconds
+     * @param clearUs Duration of a pulse turning dots off, in microseconds
+     */
+    void setBoardPulseDurationUs(size_t board, uint16_t setUs, uint16_t clearUs);
+
+    /**
+     * @brief Estimates how long one set or clear pulse takes, including loading the chain.
+     *
+     * Uses the longest pulse any board has been given, so it never falls short.
+     *
+     * @return Estimated time in microseconds.
+     */
+    uint32_t estimatePulseTimeUs(void) const;
+
+    /**
+     * @brief Sets whether drawing keeps track of which bytes changed
+     *
+     * Dirty tracking lets display() skip unchanged pixels, but reads the
+     * displayed buffer while drawing. Disable it when the display is driven
+     * from another thread with beginFrame(const uint8_t *).
+     *
+     * @param param Whether dirty tracking should be used
+     */
+    void setDirtyTracking(bool param);
+
     /**
      * @brief Sets whether each call to display() will take the same time
      *
      * Normally, display() will only take as long as necessary to update
      * the pixels that have changed. However if this is true, it will
      * delay as necessary so that each call takes the same time.
-     * This constant frame rate is roughly equal to:
-     *     28 * 16 * (pulseDuration + 10 + 290) = 246ms = 4.1fps
+     * The frame time is that of flipping every position of a panel,
+     * 28 * 16 * estimatePulseTimeUs(), and is waited out on the timer.
      *
      * @param param Whether constant frame rate should be used
      */
     void setConstantFrameRate(bool param);
 
+    /**
+     * @brief Returns the counters collected during the most recent display() call.
+     */
+    const MAX3000_Stats & getStats(void) const { return stats; }
+
     // Make a copy of the buffer
     void copyBuffer(uint8_t *toBuffer);
 
     // Replace the buffer
     void replaceBuffer(uint8_t *fromBuffer);
 
+    /**
+     * @brief Replaces the pixels selected by a mask, leaving the others as they are.
+     *
+     * @param mask Set bits select the pixels to replace, laid out like the buffer.
+     * @param bits New values of the selected pixels, laid out like the buffer.
+     */
+    void blendBuffer(const uint8_t *mask, const uint8_t *bits);
+
+    /**
+     * @brief Replaces the buffer with a display-wide window onto a wider image.
+     *
+     * The image is laid out like the buffer and has as many rows, so each 8-row page of the
+     * window is a single copy. Columns of the window beyond the image are cleared.
+     *
+     * @param image The image, such as a strip of scrolling text.
+     * @param imageWidth Width of the image in pixels.
+     * @param left Column of the image shown in the leftmost column of the display. May be
+     *             negative, or past the end of the image.
+     */
+    void copyWindow(const uint8_t *image, int32_t imageWidth, int32_t left);
+
+    /**
+     * @brief Decodes a frame packet straight into the buffer.
+     *
+     * A packet starts with its type, one of the MAX3000_PACKET_* values, and a sequence
+     * number. The rest is in the buffer's own page-packed layout:
+     * - MAX3000_PACKET_FULL: the whole buffer.
+     * - MAX3000_PACKET_XOR: the whole buffer, XORed with the previous frame.
+     * - MAX3000_PACKET_XOR_RLE: runs of the XOR with the previous frame. A byte n below
+     *   0x80 skips n + 1 unchanged bytes; a byte n of 0x80 or more is followed by
+     *   (n & 0x7F) + 1 bytes to XOR in. Runs left out at the end are unchanged.
+     *
+     * Deltas only apply on top of the frame whose sequence number is one lower. Drawing
+     * into the buffer between packets isn't tracked, so the sender has to account for it.
+     *
+     * @param packet The packet, header included.
+     * @param length Length of the packet in bytes.
+     * @return True if the buffer now holds the frame. False if the packet was malformed or
+     *         isn't based on the frame in the buffer, which is then left as it was.
+     */
+    bool applyFramePacket(const uint8_t *packet, size_t length);
+
+    /**
+     * @brief Makes delta packets wait for a full frame, for when something else draws into the buffer.
+     */
+    void invalidateFramePackets(void) { framePacketValid = false; }
+
   protected:
     /**
      * @brief Constructs a new MAX3000_Base object.
@@ -279,10 +715,20 @@ class MAX3000_Base {
     /**
      * @brief Writes shift register buffer out to display drivers.
      *
-     * See HAVE_PORTREG which defines if the method uses a port or bit-bang method.
+     * Uses the hardware SPI peripheral from the config when one is set,
+     * otherwise bit-bangs the MOSI and CLK pins.
      */
     inline void shiftRegWrite() __attribute__((always_inline));
 
+    /**
+     * @brief Looks up the set and clear registers of a pin.
+     *
+     * @param pin Pin to look up.
+     * @param fast Receives the registers and mask.
+     * @return false if the pin can't be written directly on this platform.
+     */
+    static bool resolveFastPin(GPIOPin *pin, MAX3000_FastPin & fast);
+
     /**
      * @brief Stores the appropriate decoder inputs to the shift register buffer.
      *
@@ -292,20 +738,119 @@ class MAX3000_Base {
      */
     void selectRowColumn(size_t board, size_t row, size_t column);
 
+    /**
+     * @brief Marks the bytes in a range of the buffer that differ from what is displayed.
+     *
+     * @param offset First byte of the buffer to check.
+     * @param length Number of bytes to check.
+     */
+    void markDirtyBytes(size_t offset, size_t length);
+
+    /**
+     * @brief Set/clear/invert a rectangle given in unrotated buffer coordinates.
+     *
+     * The rectangle must already be clipped to the buffer.
+     */
+    void fillBufferRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+    /**
+     * @brief XORs four bytes of a frame against the displayed buffer.
+     *
+     * @param frame Pixels to compare, laid out like the buffer.
+     * @param offset Byte offset into the buffer, a multiple of 4.
+     * @param all When true, every bit is reported as changed.
+     * @return The changed bits, or 0 if none of the bytes are dirty.
+     */
+    uint32_t diffWord(const uint8_t *frame, size_t offset, bool all);
+
+    /**
+     * @brief Fills the change list with every pixel of a frame that differs from what is displayed.
+     *
+     * The list is grouped by board, see boardChanges, and within each board
+     * the pixels to set come before the pixels to clear, see boardSplit.
+     *
+     * @param frame Pixels to compare, laid out like the buffer.
+     * @param force When true, every pixel is listed as changed.
+     * @return Number of changes found.
+     */
+    size_t diffBuffer(const uint8_t *frame, bool force);
+
+    /**
+     * @brief Clears the dirty bit of every byte that matches what is displayed.
+     *
+     * @return true if any byte is still dirty.
+     */
+    bool refreshDirtyBytes(void);
+
+    /**
+     * @brief Loads the shift register image for one set or clear pulse.
+     *
+     * Selects the next pixel of every board with a bit in pending and sources
+     * it, advancing the board's cursor. Boards that reach the end of their
+     * part of the change list drop out of pending.
+     *
+     * @param pending One bit per board that still has pixels in this pass.
+     * @param cursor Each board's position in the change list.
+     * @param end Each board's end of this pass in the change list.
+     * @param durations Each board's pulse duration for this pass.
+     * @param source Shift register bit that sources the pulse on selected boards.
+     * @return Duration of the pulse in microseconds, the longest of the selected
+     *         boards, or 0 if no board has a pixel to flip.
+     */
+    uint16_t loadPass(uint32_t *pending, size_t *cursor, const size_t *end, const uint16_t *durations,
+        uint16_t source);
+
+    /**
+     * @brief Loads a pixel's decoder inputs for a board and stores its new value to oldBuffer.
+     *
+     * @param board Board Index, starting from 0
+     * @param change Pixel to select.
+     */
+    void selectChange(size_t board, const MAX3000_Change & change);
+
+    /**
+     * @brief Sends one set pulse and one clear pulse for the current frame.
+     *
+     * @return false once the frame has no more pixels to flip.
+     */
+    bool pulseNext();
+
+    /**
+     * @brief Marks the current frame as complete.
+     */
+    void endFrame();
+
     /**
      * Controls the various pulse lines in the correct order to turn bits on
      */
-    void setPixel();
+    void setPixel(uint16_t durationUs);
 
     /**
      * Controls the various pulse lines in the correct order to turn bits off
      */
-    void clearPixel();
+    void clearPixel(uint16_t durationUs);
 
     /**
-     * Shuffles the internal array of indexes.
+     * Shuffles a range of the change list.
      */
-    void shuffleIndex();
+    void shuffleChanges(size_t first, size_t last);
+
+    /**
+     * @brief Records the dots the current frame hasn't flipped yet in carriedMask.
+     */
+    void markCarriedChanges(void);
+
+    /**
+     * @brief Bits of a panel column, across both of its pages, whose changes are listed in a rank.
+     *
+     * Rank 0 is the priority regions, rank 1 dots carried over from an unfinished frame,
+     * and rank 2 everything else.
+     *
+     * @param rank Rank to select.
+     * @param loOffset Buffer offset of the column's top page.
+     * @param hiOffset Buffer offset of the column's bottom page.
+     */
+    uint16_t rankMask(uint8_t rank, size_t loOffset, size_t hiOffset) const;
 
     /**
      * @brief Set rotation setting for display
@@ -313,15 +858,65 @@ class MAX3000_Base {
      */
     void setDisplayRotation(uint8_t r);
 
+    typedef void (MAX3000_Base::*PixelWriter)(int16_t x, int16_t y);
+    typedef bool (MAX3000_Base::*PixelReader)(int16_t x, int16_t y) const;
+
+    /**
+     * @brief Maps display coordinates to buffer coordinates for one rotation.
+     *
+     * @return false if the pixel is outside the display.
+     */
+    template <uint8_t ROTATION> inline bool rotateToBuffer(int16_t & x, int16_t & y) const;
+
+    /**
+     * @brief Sets, clears or inverts one pixel, specialized for a rotation and color.
+     */
+    template <uint8_t ROTATION, uint16_t COLOR> void writePixel(int16_t x, int16_t y);
+
+    /**
+     * @brief Sets or clears one pixel in buffer coordinates, for setPixelRot0() and clearPixelRot0().
+     */
+    inline void writePixelRot0(int16_t x, int16_t y, bool on) {
+        if((x < 0) || (x >= (int16_t) config.width) || (y < 0) || (y >= (int16_t) config.height)) {
+            return;
+        }
+        size_t offset = x + (y / 8) * config.width;
+        if(on) {
+            buffer[offset] |= (1 << (y & 7));
+        } else {
+            buffer[offset] &= ~(1 << (y & 7));
+        }
+        if(trackDirty && (buffer[offset] != oldBuffer[offset])) {
+            dirtyBytes[offset >> 3] |= (1 << (offset & 7));
+        }
+    }
+
+    /**
+     * @brief Reads one pixel, specialized for a rotation.
+     */
+    template <uint8_t ROTATION> bool readPixel(int16_t x, int16_t y) const;
+
+    /** @brief Pixel writers for the current rotation, indexed by color. Chosen by setDisplayRotation(). */
+    PixelWriter pixelWriters[3];
+
+    /** @brief Pixel reader for the current rotation. Chosen by setDisplayRotation(). */
+    PixelReader pixelReader;
+
     /** @brief Configuration of display drivers */
     MAX3000_Config config;
 
+    /** @brief Size of buffer in bytes: a page of 8 rows for every column, pages one after the other */
+    size_t bufferSize;
+
     /** @brief Internal pixel memory buffer */
     uint8_t *buffer;
 
     /** @brief The previous pixel memory buffer from the last display() call. */
     uint8_t *oldBuffer;
 
+    /** @brief One bit per byte of buffer, set when the byte may differ from oldBuffer */
+    uint8_t *dirtyBytes;
+
     /** @brief Display width as modified by current rotation */
     int16_t localWidth;
 
@@ -331,9 +926,15 @@ class MAX3000_Base {
     /** @brief Display rotation (0 thru 3) */
     uint8_t localRotation;
 
-    /** @brief Duration of each pulse in microseconds */
+    /** @brief Duration of each pulse in microseconds, for boards without their own */
     uint16_t pulseDuration;
 
+    /** @brief Duration of pulses turning dots on, per board */
+    uint16_t *setPulseUs; // numVBoards * numHBoards
+
+    /** @brief Duration of pulses turning dots off, per board */
+    uint16_t *clearPulseUs; // numVBoards * numHBoards
+
     /** @brief Whether or not the display should be white-on-black or not */
     bool invertEnabled;
 
@@ -346,11 +947,149 @@ class MAX3000_Base {
     /** @brief State flag that indicates when an update has not yet been done */
     bool firstUpdate;
 
-    /** @brief Array of length PIXEL_HEIGHT * PIXEL_WIDTH that maps indexes to a random number */
-    int shuffledIndex[PANEL_HEIGHT * PANEL_WIDTH];
+    /** @brief Whether a frame started by beginFrame() still has pixels to flip */
+    bool frameActive;
+
+    /** @brief Whether a forced frame was started and has not yet completed */
+    bool forcePending;
+
+    /** @brief Whether drawing marks changed bytes in dirtyBytes */
+    bool trackDirty;
+
+    /** @brief Most dots flipped per display() or displayStep() call, or 0 for no limit */
+    uint32_t flipBudget;
+
+    /** @brief Order of each board's pending dots, one of the MAX3000_FLIP_* values */
+    uint8_t flipOrder;
+
+    /** @brief Whether any bit of priorityMask is set */
+    bool priorityEnabled;
+
+    /** @brief Dots in a priority region, laid out like the buffer */
+    uint8_t *priorityMask; // bufferSize
+
+    /** @brief Dots that were still pending when the last frame was replaced, laid out like the buffer */
+    uint8_t *carriedMask; // bufferSize
+
+    /** @brief Pixels that differ from what is displayed, grouped by board */
+    MAX3000_Change *changes; // numVBoards * numHBoards * PANEL_HEIGHT * PANEL_WIDTH
+
+    /** @brief Index of each board's first entry in changes, plus one past the last board's */
+    size_t *boardChanges; // numVBoards * numHBoards + 1
+
+    /** @brief Offset of each board's top left pixel in the buffer, following config.boardOrder */
+    size_t *boardOffset; // numVBoards * numHBoards
+
+    /** @brief Rotation of each board, 0 or 2 */
+    uint8_t *boardRotation; // numVBoards * numHBoards
+
+    /** @brief Index of each board's first pixel to clear in changes, after its pixels to set */
+    size_t *boardSplit; // numVBoards * numHBoards
+
+    /** @brief Each board's position in the change list for pixels to set */
+    size_t *setCursor; // numVBoards * numHBoards
+
+    /** @brief Each board's position in the change list for pixels to clear */
+    size_t *clearCursor; // numVBoards * numHBoards
+
+    /** @brief One bit per board that still has pixels to set in the current frame */
+    uint32_t *setPending; // (numVBoards * numHBoards + 31) / 32
+
+    /** @brief One bit per board that still has pixels to clear in the current frame */
+    uint32_t *clearPending; // (numVBoards * numHBoards + 31) / 32
 
     /** @brief Array with length of number of boards, storing the 16-bit shift register contents to send */
     uint16_t *shiftReg; // numVBoards * numHBoards
+
+    /** @brief Shift register contents as last latched, valid once latchedValid is set */
+    uint16_t *latchedReg; // numVBoards * numHBoards
+
+    /** @brief Registers of the driver pins, valid when fastGpio is set */
+    MAX3000_FastPin fastMosi, fastSclk, fastLat, fastPulse, fastCol, fastRow;
+
+    /** @brief Sequence number of the last frame packet applied, valid once framePacketValid is set */
+    uint8_t framePacketSequence;
+
+    /** @brief Whether the buffer holds a frame a delta packet can apply to */
+    bool framePacketValid;
+
+    /** @brief Registers of the pins of each extra chain, valid when fastGpio is set */
+    MAX3000_ChainFastPins chainFast[MAX3000_MAX_CHAINS];
+
+    /** @brief Number of boards on the main chain, the ones not claimed by an extra chain */
+    size_t mainBoards;
+
+    /** @brief Index of the first board of each extra chain */
+    size_t chainStart[MAX3000_MAX_CHAINS];
+
+    /** @brief Number of boards on the longest chain, which sets the time to load them all */
+    size_t longestChain;
+
+    /** @brief Whether the driver pins are written through fastMosi etc. instead of GPIOPin */
+    bool fastGpio;
+
+    /** @brief CPU cycles to wait after each bit-bang edge, from config.shiftClockHz */
+    uint32_t bitbangCycles;
+
+    /** @brief Whether latchedReg matches what the chain is outputting */
+    bool latchedValid;
+
+    /** @brief Counters for the most recent display() call */
+    MAX3000_Stats stats;
+
+    /** @brief Big-endian copy of shiftReg handed to the hardware SPI peripheral in one transfer */
+    uint8_t *spiBuffer; // 2 * numVBoards * numHBoards
+};
+
+#define FRAME_INDEX 0x03    // Buffer index part of MAX3000_FrameHandoff::middle
+#define FRAME_FRESH 0x04    // Set when the middle buffer holds a frame the reader hasn't taken
+
+/**
+ * @brief Lock-free handoff of whole frames from one writer thread to one reader thread.
+ *
+ * Three buffers rotate between the writer, the reader and a middle slot. The
+ * writer fills writeBuffer() and publishes it into the middle slot; the reader
+ * swaps the middle slot out when it holds a newer frame. Neither side ever
+ * waits, and a frame the reader didn't get to in time is replaced by the next
+ * one, so the reader always gets the latest complete frame and never a torn one.
+ */
+class MAX3000_FrameHandoff {
+  public:
+    /**
+     * @brief Allocate the three buffers.
+     *
+     * @param size Size of one frame in bytes.
+     * @return Returns true on successful allocation.
+     */
+    bool begin(size_t size);
+
+    /**
+     * @brief Buffer the writer fills before calling publish().
+     */
+    uint8_t *writeBuffer(void) { return buffers[writeIndex]; }
+
+    /**
+     * @brief Makes the write buffer the latest frame, replacing any frame not yet acquired.
+     */
+    void publish(void);
+
+    /**
+     * @brief Takes the latest frame, if one was published since the last call.
+     *
+     * @return The frame, which stays valid until the next call, or NULL if there is no new frame.
+     */
+    const uint8_t *acquire(void);
+
+    /**
+     * @brief Whether a published frame is waiting to be acquired.
+     */
+    bool pending(void) const { return middle.load(std::memory_order_acquire) & FRAME_FRESH; }
+
+  private:
+    uint8_t *buffers[3];
+    uint8_t writeIndex;
+    uint8_t readIndex;
+    std::atomic<uint8_t> middle;
 };
 
 /**
@@ -370,7 +1109,7 @@ class MAX3000_Display : public MAX3000_Base {
      * @param config \ref MAX3000_Config object containing parameters for display
      */
     MAX3000_Display(const MAX3000_Config & config)
-        : MAX3000_Base(config) {
+        : MAX3000_Base(config), rotation(0) {
     }
 
     /**
@@ -409,6 +1148,88 @@ class MAX3000_Display : public MAX3000_Base {
     uint8_t rotation;    ///< Display rotation (0 thru 3)
 };
 
+/**
+ * @brief One recorded drawing operation: a rectangle of one color, in buffer coordinates.
+ */
+struct MAX3000_DrawOp {
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    bool on;
+};
+
+/**
+ * @brief Counters collected by MAX3000_DrawBatch since the last reset().
+ */
+struct MAX3000_DrawStats {
+    uint32_t ops;              // Operations recorded, after merging adjacent pixels
+    uint32_t pixelsDrawn;      // Pixels covered by all operations, counting overdraw
+    uint32_t pixelsWritten;    // Distinct pixels written to the buffer
+    uint32_t rasterizeUs;      // Time spent rasterizing and writing to the buffer
+};
+
+/**
+ * @brief Records drawing operations and writes them to a display buffer in one pass.
+ *
+ * Pixels drawn next to each other in the same color are merged into spans
+ * as they are recorded. On commit() the operations are rasterized from last
+ * to first into a coverage mask, so each pixel is written once with its
+ * final color no matter how often it was drawn over, and the result is
+ * blended into the display buffer.
+ */
+class MAX3000_DrawBatch {
+  public:
+    /**
+     * @brief Allocate the operation list and the scratch frames.
+     *
+     * @param target Display the operations are committed to.
+     * @param width Width of the display buffer in pixels.
+     * @param height Height of the display buffer in pixels.
+     * @param capacity Operations kept before they are written out early.
+     * @return Returns true on successful allocation.
+     */
+    bool begin(MAX3000_Base *target, int16_t width, int16_t height, size_t capacity);
+
+    /**
+     * @brief Drops any recorded operations and clears the counters.
+     */
+    void reset(void);
+
+    /**
+     * @brief Records a single pixel.
+     */
+    void addPixel(int16_t x, int16_t y, bool on) { addRect(x, y, 1, 1, on); }
+
+    /**
+     * @brief Records a filled rectangle, clipped to the buffer.
+     */
+    void addRect(int16_t x, int16_t y, int16_t w, int16_t h, bool on);
+
+    /**
+     * @brief Writes all recorded operations to the display buffer.
+     */
+    void commit(void);
+
+    /**
+     * @brief Returns the counters collected since the last reset().
+     */
+    const MAX3000_DrawStats & getStats(void) const { return stats; }
+
+  private:
+    void rasterize(const MAX3000_DrawOp & op);
+
+    MAX3000_Base *target;
+    int16_t width;
+    int16_t height;
+    MAX3000_DrawOp *ops;
+    size_t capacity;
+    size_t count;
+    uint8_t *covered;    // Pixels already written by a later operation
+    uint8_t *bits;       // Final values of the covered pixels
+    MAX3000_DrawStats stats;
+};
+
 #endif    // _MAX3000_Lib_H_
 
 }  // namespace max3000
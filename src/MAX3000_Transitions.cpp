@@ -0,0 +1,354 @@
+/**
+ * @file MAX3000_Transitions.cpp
+ *
+ * Transition effects played between two frames of a MAX3000 Display.
+ */
+
+#include "MAX3000_Transitions.h"
+#include "MAX3000_Lib.h"
+
+namespace esphome {
+namespace max3000 {
+
+static inline bool getBit(const uint8_t *frame, int16_t width, int16_t height, int16_t x, int16_t y) {
+    if((x < 0) || (x >= width) || (y < 0) || (y >= height)) {
+        return false;    // Pixel out of bounds
+    }
+    return frame[x + (y / 8) * width] & (1 << (y & 7));
+}
+
+static inline void setBit(uint8_t *frame, int16_t width, int16_t x, int16_t y, bool on) {
+    if(on) {
+        frame[x + (y / 8) * width] |= (1 << (y & 7));
+    } else {
+        frame[x + (y / 8) * width] &= ~(1 << (y & 7));
+    }
+}
+
+// Shows 'after' behind a double thickness line and 'before' ahead of it.
+static inline bool wipePixel(const MAX3000_TransitionFrames & f, int16_t x, int16_t y, int line) {
+    if(x < line) {
+        return getBit(f.after, f.width, f.height, x, y);
+    }
+    if(x <= line + 1) {
+        return true;
+    }
+    return getBit(f.before, f.width, f.height, x, y);
+}
+
+MAX3000_TransitionCost MAX3000_Transition::estimateCost(const MAX3000_TransitionFrames & frames,
+    uint32_t pulseTimeUs, uint32_t stepDelayMs) const {
+    MAX3000_TransitionCost cost;
+    memset(&cost, 0, sizeof(cost));
+
+    size_t size       = frames.width * ((frames.height + 7) / 8);
+    size_t numHBoards = frames.width / PANEL_WIDTH;
+    size_t numVBoards = frames.height / PANEL_HEIGHT;
+    uint8_t *shown    = new uint8_t[size];
+    memcpy(shown, frames.before, size);
+
+    uint64_t durationUs = 0;
+    int steps           = numSteps(frames.width, frames.height);
+    for(int step = nextStep(-1, frames);; step = nextStep(step, frames)) {
+        const uint8_t *next = frames.after;
+        if(step < steps) {
+            compose(step, frames);
+            next = frames.out;
+            cost.steps++;
+        }
+
+        // Every board flips one dot per pulse, with sets and clears in separate
+        // pulses, so a step takes as many pulses as its busiest board needs.
+        uint32_t maxSets = 0, maxClears = 0;
+        for(size_t board = 0; board < numHBoards * numVBoards; ++board) {
+            uint32_t sets = 0, clears = 0;
+            size_t boardX = (board % numHBoards) * PANEL_WIDTH;
+            size_t page   = (board / numHBoards) * PANEL_HEIGHT / 8;
+            for(size_t p = page; p < page + PANEL_HEIGHT / 8; ++p) {
+                for(size_t x = boardX; x < boardX + PANEL_WIDTH; ++x) {
+                    uint8_t diff = shown[x + p * frames.width] ^ next[x + p * frames.width];
+                    sets += __builtin_popcount(diff & next[x + p * frames.width]);
+                    clears += __builtin_popcount(diff & ~next[x + p * frames.width]);
+                }
+            }
+            cost.dotFlips += sets + clears;
+            maxSets   = (sets > maxSets) ? sets : maxSets;
+            maxClears = (clears > maxClears) ? clears : maxClears;
+        }
+        cost.pulses += maxSets + maxClears;
+
+        uint32_t stepUs = (maxSets + maxClears) * pulseTimeUs;
+        durationUs += (stepUs > stepDelayMs * 1000) ? stepUs : stepDelayMs * 1000;
+        memcpy(shown, next, size);
+
+        if(step >= steps) {
+            break;
+        }
+    }
+
+    delete[] shown;
+    cost.durationMs = durationUs / 1000;
+    return cost;
+}
+
+/**
+ * @brief Base class for transitions that only flip the dots that differ.
+ *
+ * Instead of painting a bar over the display, each dot that differs between
+ * 'before' and 'after' is flipped once, at the step revealStep() gives it.
+ * Dots that are the same in both frames are never pulsed, and steps that
+ * would flip nothing are skipped, so the cost of the transition follows the
+ * content that changed rather than the display area.
+ */
+class MAX3000_RevealTransition : public MAX3000_Transition {
+  public:
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t page = 0; page < (f.height + 7) / 8; page++) {
+            for(int16_t x = 0; x < f.width; x++) {
+                size_t i     = x + page * f.width;
+                uint8_t mask = f.before[i] ^ f.after[i];
+                uint8_t reveal = 0;
+                for(uint8_t bit = 0; mask >> bit; bit++) {
+                    if((mask & (1 << bit)) && (revealStep(x, page * 8 + bit, f.width, f.height) <= step)) {
+                        reveal |= (1 << bit);
+                    }
+                }
+                f.out[i] = f.before[i] ^ reveal;
+            }
+        }
+    }
+
+    int nextStep(int step, const MAX3000_TransitionFrames & f) const override {
+        // Skip ahead to the first later step that flips a dot
+        int next = numSteps(f.width, f.height);
+        for(int16_t page = 0; page < (f.height + 7) / 8; page++) {
+            for(int16_t x = 0; x < f.width; x++) {
+                uint8_t mask = f.before[x + page * f.width] ^ f.after[x + page * f.width];
+                for(uint8_t bit = 0; mask >> bit; bit++) {
+                    if(mask & (1 << bit)) {
+                        int revealAt = revealStep(x, page * 8 + bit, f.width, f.height);
+                        if((revealAt > step) && (revealAt < next)) {
+                            next = revealAt;
+                        }
+                    }
+                }
+            }
+        }
+        return next;
+    }
+
+  protected:
+    /**
+     * @brief Step at which the dot at x, y flips to its 'after' value.
+     */
+    virtual int revealStep(int16_t x, int16_t y, int16_t width, int16_t height) const = 0;
+};
+
+/**
+ * @brief A simple horizontal wipe from left to right.
+ */
+class MAX3000_WipeTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "wipe"; }
+    int numSteps(int16_t width, int16_t height) const override { return width; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t x = 0; x < f.width; x++) {
+            for(int16_t y = 0; y < f.height; y++) {
+                setBit(f.out, f.width, x, y, wipePixel(f, x, y, step));
+            }
+        }
+    }
+};
+
+/**
+ * @brief A diagonal swipe, the wipe line leaning back one column per row.
+ */
+class MAX3000_DiagonalTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "diagonal"; }
+    int numSteps(int16_t width, int16_t height) const override { return width + height; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t x = 0; x < f.width; x++) {
+            for(int16_t y = 0; y < f.height; y++) {
+                setBit(f.out, f.width, x, y, wipePixel(f, x, y, step - y));
+            }
+        }
+    }
+};
+
+/**
+ * @brief Reveals the 'after' frame a random scattering of pixels at a time.
+ */
+class MAX3000_DissolveTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "dissolve"; }
+    int numSteps(int16_t width, int16_t height) const override { return 16; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t x = 0; x < f.width; x++) {
+            for(int16_t y = 0; y < f.height; y++) {
+                // Hash the position so every pixel gets a fixed, scattered step
+                uint32_t h = (uint32_t)(x * f.height + y) * 2654435761u;
+                h ^= h >> 16;
+                bool revealed = (int)(h % 16) <= step;
+                setBit(f.out, f.width, x, y,
+                    getBit(revealed ? f.after : f.before, f.width, f.height, x, y));
+            }
+        }
+    }
+};
+
+/**
+ * @brief Two lines moving outwards from the middle, like a curtain opening.
+ */
+class MAX3000_CurtainTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "curtain"; }
+    int numSteps(int16_t width, int16_t height) const override { return (width + 1) / 2 + 1; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t x = 0; x < f.width; x++) {
+            // Distance from the middle, the same for both halves
+            int16_t fromMiddle = (x < f.width / 2) ? (f.width / 2 - 1 - x) : (x - f.width / 2);
+            for(int16_t y = 0; y < f.height; y++) {
+                bool on;
+                if(fromMiddle < step - 1) {
+                    on = getBit(f.after, f.width, f.height, x, y);
+                } else if(fromMiddle <= step) {
+                    on = true;
+                } else {
+                    on = getBit(f.before, f.width, f.height, x, y);
+                }
+                setBit(f.out, f.width, x, y, on);
+            }
+        }
+    }
+};
+
+/**
+ * @brief A wipe from top to bottom.
+ */
+class MAX3000_VerticalTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "vertical"; }
+    int numSteps(int16_t width, int16_t height) const override { return height; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        for(int16_t x = 0; x < f.width; x++) {
+            for(int16_t y = 0; y < f.height; y++) {
+                bool on;
+                if(y < step) {
+                    on = getBit(f.after, f.width, f.height, x, y);
+                } else if(y <= step + 1) {
+                    on = true;
+                } else {
+                    on = getBit(f.before, f.width, f.height, x, y);
+                }
+                setBit(f.out, f.width, x, y, on);
+            }
+        }
+    }
+};
+
+/**
+ * @brief The 'after' frame slides in from the right, pushing the 'before' frame out.
+ */
+class MAX3000_PushTransition : public MAX3000_Transition {
+  public:
+    const char *name(void) const override { return "push"; }
+    int numSteps(int16_t width, int16_t height) const override { return width - 1; }
+    void compose(int step, const MAX3000_TransitionFrames & f) const override {
+        int16_t shift = step + 1;
+        for(int16_t x = 0; x < f.width; x++) {
+            for(int16_t y = 0; y < f.height; y++) {
+                bool on = (x < f.width - shift) ? getBit(f.before, f.width, f.height, x + shift, y)
+                                                : getBit(f.after, f.width, f.height, x - (f.width - shift), y);
+                setBit(f.out, f.width, x, y, on);
+            }
+        }
+    }
+};
+
+/**
+ * @brief Flips the dots that changed, column by column from left to right.
+ */
+class MAX3000_RevealWipeTransition : public MAX3000_RevealTransition {
+  public:
+    const char *name(void) const override { return "reveal_wipe"; }
+    int numSteps(int16_t width, int16_t height) const override { return width; }
+
+  protected:
+    int revealStep(int16_t x, int16_t y, int16_t width, int16_t height) const override { return x; }
+};
+
+/**
+ * @brief Flips the dots that changed along a diagonal line.
+ */
+class MAX3000_RevealDiagonalTransition : public MAX3000_RevealTransition {
+  public:
+    const char *name(void) const override { return "reveal_diagonal"; }
+    int numSteps(int16_t width, int16_t height) const override { return width + height - 1; }
+
+  protected:
+    int revealStep(int16_t x, int16_t y, int16_t width, int16_t height) const override { return x + y; }
+};
+
+/**
+ * @brief Flips the dots that changed in a random order.
+ */
+class MAX3000_RevealRandomTransition : public MAX3000_RevealTransition {
+  public:
+    const char *name(void) const override { return "reveal_random"; }
+    int numSteps(int16_t width, int16_t height) const override { return 16; }
+
+  protected:
+    int revealStep(int16_t x, int16_t y, int16_t width, int16_t height) const override {
+        // Same scattering as the dissolve transition
+        uint32_t h = (uint32_t)(x * height + y) * 2654435761u;
+        h ^= h >> 16;
+        return h % 16;
+    }
+};
+
+static const MAX3000_WipeTransition wipeTransition;
+static const MAX3000_DiagonalTransition diagonalTransition;
+static const MAX3000_DissolveTransition dissolveTransition;
+static const MAX3000_CurtainTransition curtainTransition;
+static const MAX3000_VerticalTransition verticalTransition;
+static const MAX3000_PushTransition pushTransition;
+static const MAX3000_RevealWipeTransition revealWipeTransition;
+static const MAX3000_RevealDiagonalTransition revealDiagonalTransition;
+static const MAX3000_RevealRandomTransition revealRandomTransition;
+
+// Order matters: transitions are also selected by number, starting from 1.
+static const MAX3000_Transition *const transitions[] = {
+    &wipeTransition,
+    &diagonalTransition,
+    &dissolveTransition,
+    &curtainTransition,
+    &verticalTransition,
+    &pushTransition,
+    &revealWipeTransition,
+    &revealDiagonalTransition,
+    &revealRandomTransition,
+};
+
+size_t MAX3000_numTransitions(void) {
+    return sizeof(transitions) / sizeof(transitions[0]);
+}
+
+const MAX3000_Transition *MAX3000_findTransition(int number) {
+    if((number < 1) || ((size_t)number > MAX3000_numTransitions())) {
+        return NULL;
+    }
+    return transitions[number - 1];
+}
+
+const MAX3000_Transition *MAX3000_findTransition(const char *name) {
+    for(size_t i = 0; i < MAX3000_numTransitions(); ++i) {
+        if(strcmp(transitions[i]->name(), name) == 0) {
+            return transitions[i];
+        }
+    }
+    return NULL;
+}
+
+}  // namespace max3000
+}  // namespace esphome
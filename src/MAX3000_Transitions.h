@@ -0,0 +1,127 @@
+#include "esphome/core/hal.h"
+
+namespace esphome {
+namespace max3000 {
+
+
+/**
+ * @file MAX3000_Transitions.h
+ *
+ * Transition effects played between two frames of a MAX3000 Display.
+ *
+ * Each transition composes a sequence of frames from the frame shown before
+ * it and the frame to show after it. Frames use the same page-packed layout
+ * as the MAX3000_Base buffer.
+ */
+
+#ifndef _MAX3000_Transitions_H_
+#define _MAX3000_Transitions_H_
+
+/**
+ * @brief The frames a transition is composed from, and where to write each step.
+ */
+struct MAX3000_TransitionFrames {
+    const uint8_t *before;    // Frame shown when the transition starts
+    const uint8_t *after;     // Frame shown when the transition ends
+    uint8_t *out;             // Receives the composed step
+    int16_t width;            // Width of the frames in pixels
+    int16_t height;           // Height of the frames in pixels
+};
+
+/**
+ * @brief Estimated cost of playing a transition on the display.
+ */
+struct MAX3000_TransitionCost {
+    uint32_t steps;         // Number of steps shown
+    uint32_t dotFlips;      // Dots flipped over the whole transition, summed over all boards
+    uint32_t pulses;        // Pulses needed, with one dot flipped per board per pulse
+    uint32_t durationMs;    // Time the display stays busy
+};
+
+/**
+ * @brief Base class for transition effects.
+ */
+class MAX3000_Transition {
+  public:
+    /**
+     * @brief Virtual Destructor
+     */
+    virtual ~MAX3000_Transition(void) {}
+
+    /**
+     * @brief Name used to select the transition.
+     */
+    virtual const char *name(void) const = 0;
+
+    /**
+     * @brief Number of steps the transition shows before the 'after' frame.
+     *
+     * @param width Width of the frames in pixels.
+     * @param height Height of the frames in pixels.
+     */
+    virtual int numSteps(int16_t width, int16_t height) const = 0;
+
+    /**
+     * @brief Composes one step of the transition into frames.out.
+     *
+     * @param step Step to compose, from 0 to numSteps() - 1.
+     * @param frames The before and after frames, and the output frame.
+     */
+    virtual void compose(int step, const MAX3000_TransitionFrames & frames) const = 0;
+
+    /**
+     * @brief Step to show after the given one.
+     *
+     * Transitions that know some steps would not change anything can skip
+     * them. By default every step is shown.
+     *
+     * @param step Step last shown, or -1 to get the first step.
+     * @param frames The before and after frames.
+     * @return The next step, or numSteps() or more when the transition is over.
+     */
+    virtual int nextStep(int step, const MAX3000_TransitionFrames & frames) const { return step + 1; }
+
+    /**
+     * @brief Estimates the cost of playing the transition between two frames.
+     *
+     * Composes every step shown and counts the dots that change from one step to the
+     * next, including the final change to the 'after' frame. Each step takes as
+     * long as its pulses, or stepDelayMs if that is longer.
+     *
+     * @param frames The before and after frames. frames.out is used as scratch space.
+     * @param pulseTimeUs Time of one set or clear pulse, see MAX3000_Base::estimatePulseTimeUs().
+     * @param stepDelayMs Minimum time between steps in milliseconds.
+     * @return The estimated cost.
+     */
+    MAX3000_TransitionCost estimateCost(const MAX3000_TransitionFrames & frames, uint32_t pulseTimeUs,
+        uint32_t stepDelayMs) const;
+};
+
+/**
+ * @brief Number of transitions in the registry.
+ */
+size_t MAX3000_numTransitions(void);
+
+/**
+ * @brief Looks up a transition by its position in the registry.
+ *
+ * Numbers start from 1, so that 1 is the horizontal wipe and 2 the diagonal
+ * wipe, as accepted by MAX3000::transitionOnNextUpdate(int).
+ *
+ * @param number Position in the registry, starting from 1.
+ * @return The transition, or NULL if there is none with that number.
+ */
+const MAX3000_Transition *MAX3000_findTransition(int number);
+
+/**
+ * @brief Looks up a transition by name.
+ *
+ * @param name Name of the transition.
+ * @return The transition, or NULL if there is none with that name.
+ */
+const MAX3000_Transition *MAX3000_findTransition(const char *name);
+
+#endif    // _MAX3000_Transitions_H_
+
+}  // namespace max3000
+}  // namespace esphome
@@ -1,11 +1,25 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.components import display
-from esphome import pins
+from esphome.components import display, spi
+from esphome import automation, core, pins
+from esphome.core import CORE
 from esphome.const import (
+    CONF_FILE,
+    CONF_HEIGHT,
     CONF_ID,
+    CONF_INVERTED,
     CONF_LAMBDA,
-    CONF_PAGES
+    CONF_NAME,
+    CONF_PAGES,
+    CONF_PLATFORM,
+    CONF_RAW_DATA_ID,
+    CONF_RESIZE,
+    CONF_ROTATION,
+    CONF_SPI_ID,
+    CONF_TEXT,
+    CONF_WIDTH,
+    CONF_X,
+    CONF_Y,
 )
 # Pin names
 CLK_PIN = "clk_pin"
@@ -19,29 +33,311 @@ RESET_PIN = "reset_pin"
 CONF_WIDE = "num_width"
 CONF_HIGH = "num_height"
 
+# Drawing coordinates are 16 bit signed, which bounds the display to 32767 pixels each way
+MAX_WIDE = 32767 // 28
+MAX_HIGH = 32767 // 16
+
+# Hardware SPI options
+CONF_SPI_DATA_RATE = "spi_data_rate"
+
 # Other options
 CONF_DISSOLVE = "dissolve"
+CONF_INCREMENTAL = "incremental"
+CONF_SLICE_TIME = "slice_time"
+CONF_DRIVER_TASK = "driver_task"
+CONF_DRIVER_TASK_CORE = "driver_task_core"
+CONF_PAGE_TRANSITION = "page_transition"
+CONF_BATCH_DRAW = "batch_draw"
+CONF_FAST_GPIO = "fast_gpio"
+CONF_PULSE_DURATION = "pulse_duration"
+CONF_BOARD_PULSE_DURATIONS = "board_pulse_durations"
+CONF_BOARD = "board"
+CONF_SET = "set"
+CONF_CLEAR = "clear"
+CONF_BOARD_ORDER = "board_order"
+CONF_ROTATED_BOARDS = "rotated_boards"
+CONF_FRAME_PORT = "frame_port"
+CONF_FRAME_TIMEOUT = "frame_timeout"
+CONF_ANIMATIONS = "animations"
+CONF_CHAINS = "chains"
+CONF_FONT = "font"
+CONF_SPEED = "speed"
+CONF_REPEAT = "repeat"
+CONF_NUM_BOARDS = "num_boards"
+CONF_FLIP_BUDGET = "flip_budget"
+CONF_FLIP_ORDER = "flip_order"
+CONF_PRIORITY_REGIONS = "priority_regions"
+
+# Extra chains in MAX3000_Config, see MAX3000_MAX_CHAINS
+MAX_CHAINS = 4
+
+# Values of the MAX3000_ORDER_* constants in MAX3000_Lib.h
+BOARD_ORDERS = {
+    "row_major": 0,
+    "row_major_bounce": 1,
+    "column_major": 2,
+    "column_major_bounce": 3,
+}
+CONF_SHIFT_CLOCK_RATE = "shift_clock_rate"
+
+# Values of the MAX3000_FLIP_* constants in MAX3000_Lib.h
+FLIP_ORDERS = {
+    "spatial": 0,
+    "oldest": 1,
+}
+
+# Names of the transitions in MAX3000_Transitions.cpp, in registry order
+TRANSITIONS = [
+    "wipe",
+    "diagonal",
+    "dissolve",
+    "curtain",
+    "vertical",
+    "push",
+    "reveal_wipe",
+    "reveal_diagonal",
+    "reveal_random",
+]
+
+def AUTO_LOAD():
+    # Only the frame sink needs sockets, so configs without a frame_port don't pull them in
+    displays = (getattr(CORE, "raw_config", None) or {}).get("display") or []
+    if not isinstance(displays, list):
+        displays = [displays]
+    for conf in displays:
+        if isinstance(conf, dict) and conf.get(CONF_PLATFORM) == "max3000" and CONF_FRAME_PORT in conf:
+            return ["socket"]
+    return []
 
 max3000_ns = cg.esphome_ns.namespace('max3000')
 MAX3000 = max3000_ns.class_('MAX3000', cg.Component, display.DisplayBuffer)
+ScrollStartAction = max3000_ns.class_("ScrollStartAction", automation.Action)
+ScrollStopAction = max3000_ns.class_("ScrollStopAction", automation.Action)
+ScrollSetAction = max3000_ns.class_("ScrollSetAction", automation.Action)
+
+
+def validate_shift_pins(config):
+    # The shift registers are either loaded by a hardware SPI bus, or bit-banged on clk_pin and mosi_pin
+    if CONF_SPI_ID in config:
+        if CLK_PIN in config or MOSI_PIN in config:
+            raise cv.Invalid(f"{CLK_PIN} and {MOSI_PIN} belong to the SPI bus when {CONF_SPI_ID} is set")
+    elif CLK_PIN not in config or MOSI_PIN not in config:
+        raise cv.Invalid(f"Either {CONF_SPI_ID} or both {CLK_PIN} and {MOSI_PIN} are required")
+    return config
+
+
+BOARD_PULSE_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_BOARD): cv.int_range(min=0),
+        cv.Required(CONF_SET): cv.All(
+            cv.positive_time_period_microseconds,
+            cv.Range(max=cv.TimePeriod(microseconds=65535)),
+        ),
+        cv.Optional(CONF_CLEAR): cv.All(
+            cv.positive_time_period_microseconds,
+            cv.Range(max=cv.TimePeriod(microseconds=65535)),
+        ),
+    }
+)
+
+CHAIN_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_NUM_BOARDS): cv.int_range(min=1),
+        cv.Required(MOSI_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(CLK_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(LATCH_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(PULSE_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(COL_PIN): pins.gpio_output_pin_schema,
+        cv.Optional(ROW_PIN): pins.gpio_output_pin_schema,
+    }
+)
+
+PRIORITY_REGION_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_X, default=0): cv.int_range(min=0),
+        cv.Optional(CONF_Y, default=0): cv.int_range(min=0),
+        cv.Required(CONF_WIDTH): cv.int_range(min=1),
+        cv.Required(CONF_HEIGHT): cv.int_range(min=1),
+    }
+)
+
+ANIMATION_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_NAME): cv.string,
+        cv.Required(CONF_FILE): cv.file_,
+        cv.Optional(CONF_RESIZE): cv.dimensions,
+        cv.Optional(CONF_X, default=0): cv.int_,
+        cv.Optional(CONF_Y, default=0): cv.int_,
+        cv.Optional(CONF_INVERTED, default=False): cv.boolean,
+        cv.GenerateID(CONF_RAW_DATA_ID): cv.declare_id(cg.uint8),
+    }
+)
+
+# Frame packet types and header size from MAX3000_Lib.h
+PACKET_FULL = 0x01
+PACKET_XOR_RLE = 0x03
+
+def pack_frame(image, width, height, x, y, inverted):
+    # One byte per 8 rows of each column, like the MAX3000_Base buffer
+    frame = bytearray(width * ((height + 7) // 8))
+    pixels = image.load()
+    for py in range(image.height):
+        for px in range(image.width):
+            fx, fy = px + x, py + y
+            if not (0 <= fx < width and 0 <= fy < height):
+                continue
+            if (pixels[px, py] >= 128) != inverted:
+                frame[fx + (fy // 8) * width] |= 1 << (fy % 8)
+    return frame
+
+def xor_runs(frame, previous):
+    # A byte below 0x80 skips that many unchanged bytes plus one, a byte of 0x80 or
+    # more is followed by its low 7 bits plus one bytes to XOR in
+    runs = bytearray()
+    i = 0
+    while i < len(frame):
+        j = i
+        while j < len(frame) and j - i < 128 and frame[j] == previous[j]:
+            j += 1
+        if j > i:
+            if j < len(frame):
+                runs.append(j - i - 1)
+            i = j
+            continue
+        while j < len(frame) and j - i < 128 and frame[j] != previous[j]:
+            j += 1
+        runs.append(0x80 | (j - i - 1))
+        runs.extend(frame[k] ^ previous[k] for k in range(i, j))
+        i = j
+    return runs
+
+def convert_animation(animation, width, height):
+    from PIL import Image, ImageSequence
+
+    path = CORE.relative_config_path(animation[CONF_FILE])
+    try:
+        gif = Image.open(path)
+    except Exception as e:
+        raise core.EsphomeError(f"Could not load animation {path}: {e}")
+
+    data = bytearray()
+    previous = None
+    for index, image in enumerate(ImageSequence.Iterator(gif)):
+        duration = min(image.info.get("duration", 100), 65535)
+        image = image.convert("L")
+        if CONF_RESIZE in animation:
+            image = image.resize(animation[CONF_RESIZE])
+        frame = pack_frame(image, width, height, animation[CONF_X], animation[CONF_Y], animation[CONF_INVERTED])
+
+        # The first frame is whole so that playback can start on top of anything. Later ones
+        # are whichever of the delta and the whole frame is smaller.
+        sequence = index & 0xFF
+        packet = bytes([PACKET_FULL, sequence]) + frame
+        if previous is not None:
+            delta = bytes([PACKET_XOR_RLE, sequence]) + xor_runs(frame, previous)
+            if len(delta) < len(packet):
+                packet = delta
+        data += len(packet).to_bytes(2, "little") + duration.to_bytes(2, "little") + packet
+        previous = frame
+    return data
+
+def validate_chains(config):
+    chains = config.get(CONF_CHAINS, [])
+    if not chains:
+        return config
+    # Extra chains are bit-banged in step with the main one
+    if CONF_SPI_ID in config:
+        raise cv.Invalid(f"{CONF_CHAINS} can't be used with {CONF_SPI_ID}")
+    num_boards = config[CONF_WIDE] * config[CONF_HIGH]
+    if sum(chain[CONF_NUM_BOARDS] for chain in chains) >= num_boards:
+        raise cv.Invalid(f"{CONF_CHAINS} must leave at least one of the {num_boards} boards on the main chain")
+    return config
+
+def validate_board_indexes(config):
+    num_boards = config[CONF_WIDE] * config[CONF_HIGH]
+    for pulse in config.get(CONF_BOARD_PULSE_DURATIONS, []):
+        if pulse[CONF_BOARD] >= num_boards:
+            raise cv.Invalid(f"{CONF_BOARD} must be less than {num_boards}, the number of boards")
+    for board in config.get(CONF_ROTATED_BOARDS, []):
+        if board >= num_boards:
+            raise cv.Invalid(f"{CONF_ROTATED_BOARDS} must be less than {num_boards}, the number of boards")
+    width = config[CONF_WIDE] * 28
+    height = config[CONF_HIGH] * 16
+    # Regions are in drawing coordinates, which follow the display rotation
+    if config.get(CONF_ROTATION, 0) % 180:
+        width, height = height, width
+    for region in config.get(CONF_PRIORITY_REGIONS, []):
+        if region[CONF_X] + region[CONF_WIDTH] > width or region[CONF_Y] + region[CONF_HEIGHT] > height:
+            raise cv.Invalid(f"{CONF_PRIORITY_REGIONS} must fit on the {width}x{height} display")
+    return config
+
+def validate_animations(config):
+    # Animation packets carry a 16 bit length, and a whole frame has to fit in one
+    frame_size = config[CONF_WIDE] * 28 * ((config[CONF_HIGH] * 16 + 7) // 8)
+    if config.get(CONF_ANIMATIONS) and 2 + frame_size > 0xFFFF:
+        raise cv.Invalid(f"{CONF_ANIMATIONS} need frames of at most {0xFFFF - 2} bytes, this display's are {frame_size}")
+    return config
+
+DUAL_CORE_VARIANTS = ("ESP32", "ESP32S3", "ESP32P4")
+
+def validate_drive_mode(config):
+    if config[CONF_INCREMENTAL] and config.get(CONF_DRIVER_TASK, False):
+        raise cv.Invalid(f"{CONF_INCREMENTAL} and {CONF_DRIVER_TASK} cannot be used together")
+    if config.get(CONF_DRIVER_TASK, False) and config[CONF_DRIVER_TASK_CORE] > 0 and CORE.is_esp32:
+        from esphome.components.esp32 import get_esp32_variant
+
+        # The S2, C and H variants have a single core
+        variant = get_esp32_variant()
+        if variant not in DUAL_CORE_VARIANTS:
+            raise cv.Invalid(f"{CONF_DRIVER_TASK_CORE} must be 0 on the single core {variant}")
+    return config
 
 CONFIG_SCHEMA = cv.All(
     display.FULL_DISPLAY_SCHEMA.extend(
         {
             cv.GenerateID(): cv.declare_id(MAX3000),
-            cv.Required(CLK_PIN): pins.gpio_output_pin_schema,
-            cv.Required(MOSI_PIN): pins.gpio_output_pin_schema,
+            cv.Optional(CLK_PIN): pins.gpio_output_pin_schema,
+            cv.Optional(MOSI_PIN): pins.gpio_output_pin_schema,
+            cv.Optional(CONF_SPI_ID): cv.use_id(spi.SPIComponent),
+            cv.Optional(CONF_SPI_DATA_RATE, default="4MHz"): cv.frequency,
             cv.Required(COL_PIN): pins.gpio_output_pin_schema,
             cv.Required(ROW_PIN): pins.gpio_output_pin_schema,
             cv.Required(PULSE_PIN): pins.gpio_output_pin_schema,
             cv.Required(LATCH_PIN): pins.gpio_output_pin_schema,
             cv.Required(RESET_PIN): pins.gpio_output_pin_schema,
-            cv.Required(CONF_WIDE): cv.int_,
-            cv.Required(CONF_HIGH): cv.int_,
+            cv.Required(CONF_WIDE): cv.int_range(min=1, max=MAX_WIDE),
+            cv.Required(CONF_HIGH): cv.int_range(min=1, max=MAX_HIGH),
             cv.Optional(CONF_DISSOLVE, default=True): cv.boolean,
+            cv.Optional(CONF_INCREMENTAL, default=False): cv.boolean,
+            cv.Optional(CONF_SLICE_TIME, default="2ms"): cv.positive_time_period_microseconds,
+            cv.Optional(CONF_DRIVER_TASK): cv.All(cv.boolean, cv.only_on_esp32),
+            cv.Optional(CONF_DRIVER_TASK_CORE, default=0): cv.int_range(min=0, max=1),
+            cv.Optional(CONF_PAGE_TRANSITION): cv.one_of(*TRANSITIONS, lower=True),
+            cv.Optional(CONF_BATCH_DRAW, default=False): cv.boolean,
+            cv.Optional(CONF_FAST_GPIO): cv.All(cv.boolean, cv.only_on_esp32),
+            cv.Optional(CONF_SHIFT_CLOCK_RATE): cv.frequency,
+            cv.Optional(CONF_PULSE_DURATION, default="150us"): cv.All(
+                cv.positive_time_period_microseconds,
+                cv.Range(max=cv.TimePeriod(microseconds=65535)),
+            ),
+            cv.Optional(CONF_BOARD_PULSE_DURATIONS): cv.ensure_list(BOARD_PULSE_SCHEMA),
+            cv.Optional(CONF_BOARD_ORDER, default="row_major"): cv.enum(BOARD_ORDERS, lower=True),
+            cv.Optional(CONF_ROTATED_BOARDS): cv.ensure_list(cv.int_range(min=0)),
+            cv.Optional(CONF_FRAME_PORT): cv.port,
+            cv.Optional(CONF_FRAME_TIMEOUT, default="5s"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_ANIMATIONS): cv.ensure_list(ANIMATION_SCHEMA),
+            cv.Optional(CONF_CHAINS): cv.All(cv.ensure_list(CHAIN_SCHEMA), cv.Length(max=MAX_CHAINS)),
+            cv.Optional(CONF_FLIP_BUDGET): cv.int_range(min=1),
+            cv.Optional(CONF_FLIP_ORDER, default="spatial"): cv.enum(FLIP_ORDERS, lower=True),
+            cv.Optional(CONF_PRIORITY_REGIONS): cv.ensure_list(PRIORITY_REGION_SCHEMA),
         }
     ).extend(cv.polling_component_schema("1s")),
     cv.has_at_most_one_key(CONF_PAGES, CONF_LAMBDA),
+    validate_shift_pins,
+    validate_drive_mode,
+    validate_animations,
+    validate_board_indexes,
+    validate_chains,
 )
 
 async def to_code(config):
@@ -50,10 +346,15 @@ async def to_code(config):
     await display.register_display(var, config)
 
     # Apply the pin values to the C++ code
-    pin = await cg.gpio_pin_expression(config[CLK_PIN])
-    cg.add(var.set_clk_pin(pin))
-    pin = await cg.gpio_pin_expression(config[MOSI_PIN])
-    cg.add(var.set_mosi_pin(pin))
+    if CONF_SPI_ID in config:
+        spi_parent = await cg.get_variable(config[CONF_SPI_ID])
+        cg.add(var.set_spi_data_rate(int(config[CONF_SPI_DATA_RATE])))
+        cg.add(var.set_spi_parent(spi_parent))
+    else:
+        pin = await cg.gpio_pin_expression(config[CLK_PIN])
+        cg.add(var.set_clk_pin(pin))
+        pin = await cg.gpio_pin_expression(config[MOSI_PIN])
+        cg.add(var.set_mosi_pin(pin))
     pin = await cg.gpio_pin_expression(config[COL_PIN])
     cg.add(var.set_col_pin(pin))
     pin = await cg.gpio_pin_expression(config[ROW_PIN])
@@ -65,11 +366,121 @@ async def to_code(config):
     pin = await cg.gpio_pin_expression(config[RESET_PIN])
     cg.add(var.set_reset_pin(pin))
 
+    for chain in config.get(CONF_CHAINS, []):
+        chain_pins = []
+        for name in (MOSI_PIN, CLK_PIN, LATCH_PIN, PULSE_PIN, COL_PIN, ROW_PIN):
+            if name in chain:
+                chain_pins.append(await cg.gpio_pin_expression(chain[name]))
+            else:
+                chain_pins.append(cg.nullptr)
+        cg.add(var.add_chain(chain[CONF_NUM_BOARDS], *chain_pins))
+
     # Other optional settings
     cg.add(var.set_dissolve(config[CONF_DISSOLVE]))
+    cg.add(var.set_incremental(config[CONF_INCREMENTAL]))
+    cg.add(var.set_slice_time(config[CONF_SLICE_TIME]))
+    cg.add(var.set_batch_draw(config[CONF_BATCH_DRAW]))
+    cg.add(var.set_board_order(config[CONF_BOARD_ORDER]))
+    for board in config.get(CONF_ROTATED_BOARDS, []):
+        cg.add(var.add_rotated_board(board))
+    cg.add(var.set_pulse_duration(config[CONF_PULSE_DURATION]))
+    for pulse in config.get(CONF_BOARD_PULSE_DURATIONS, []):
+        clear = pulse.get(CONF_CLEAR, pulse[CONF_SET])
+        cg.add(var.add_board_pulse_duration(pulse[CONF_BOARD], pulse[CONF_SET], clear))
+    if CONF_FLIP_BUDGET in config:
+        cg.add(var.set_flip_budget(config[CONF_FLIP_BUDGET]))
+    cg.add(var.set_flip_order(config[CONF_FLIP_ORDER]))
+    for region in config.get(CONF_PRIORITY_REGIONS, []):
+        cg.add(var.add_priority_region(region[CONF_X], region[CONF_Y], region[CONF_WIDTH], region[CONF_HEIGHT]))
+    if config.get(CONF_FAST_GPIO, False):
+        cg.add(var.set_fast_gpio(True))
+    if CONF_SHIFT_CLOCK_RATE in config:
+        cg.add(var.set_shift_clock_rate(int(config[CONF_SHIFT_CLOCK_RATE])))
+    if CONF_PAGE_TRANSITION in config:
+        cg.add(var.set_page_transition(config[CONF_PAGE_TRANSITION]))
+    width = config[CONF_WIDE] * 28
+    height = config[CONF_HIGH] * 16
+    for animation in config.get(CONF_ANIMATIONS, []):
+        data = convert_animation(animation, width, height)
+        prog_arr = cg.progmem_array(animation[CONF_RAW_DATA_ID], list(data))
+        cg.add(var.add_animation(animation[CONF_NAME], prog_arr, len(data)))
+    if CONF_FRAME_PORT in config:
+        cg.add_define("USE_MAX3000_FRAME_SINK")
+        cg.add(var.set_frame_port(config[CONF_FRAME_PORT]))
+        cg.add(var.set_frame_timeout(config[CONF_FRAME_TIMEOUT]))
+    if config.get(CONF_DRIVER_TASK, False):
+        cg.add(var.set_driver_task(True))
+        cg.add(var.set_driver_task_core(config[CONF_DRIVER_TASK_CORE]))
 
     if CONF_LAMBDA in config:
         lambda_ = await cg.process_lambda(
             config[CONF_LAMBDA], [(display.DisplayBufferRef, "it")], return_type=cg.void
         )
         cg.add(var.set_writer(lambda_))
+
+
+@automation.register_action(
+    "max3000.scroll_start",
+    ScrollStartAction,
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.use_id(MAX3000),
+            cv.Required(CONF_TEXT): cv.templatable(cv.string),
+            cv.Required(CONF_FONT): cv.use_id(display.BaseFont),
+            cv.Optional(CONF_Y, default=0): cv.templatable(cv.int_),
+            cv.Optional(CONF_SPEED, default=30): cv.templatable(cv.positive_float),
+            cv.Optional(CONF_REPEAT, default=False): cv.templatable(cv.boolean),
+        }
+    ),
+)
+async def scroll_start_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    text = await cg.templatable(config[CONF_TEXT], args, cg.std_string)
+    cg.add(var.set_text(text))
+    font = await cg.get_variable(config[CONF_FONT])
+    cg.add(var.set_font(font))
+    y = await cg.templatable(config[CONF_Y], args, cg.int_)
+    cg.add(var.set_y(y))
+    speed = await cg.templatable(config[CONF_SPEED], args, cg.float_)
+    cg.add(var.set_speed(speed))
+    repeat = await cg.templatable(config[CONF_REPEAT], args, cg.bool_)
+    cg.add(var.set_repeat(repeat))
+    return var
+
+
+@automation.register_action(
+    "max3000.scroll_stop",
+    ScrollStopAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(MAX3000)}),
+)
+async def scroll_stop_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "max3000.scroll_set",
+    ScrollSetAction,
+    cv.All(
+        cv.Schema(
+            {
+                cv.GenerateID(): cv.use_id(MAX3000),
+                cv.Optional(CONF_SPEED): cv.templatable(cv.positive_float),
+                cv.Optional(CONF_REPEAT): cv.templatable(cv.boolean),
+            }
+        ),
+        cv.has_at_least_one_key(CONF_SPEED, CONF_REPEAT),
+    ),
+)
+async def scroll_set_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    if CONF_SPEED in config:
+        speed = await cg.templatable(config[CONF_SPEED], args, cg.float_)
+        cg.add(var.set_speed(speed))
+    if CONF_REPEAT in config:
+        repeat = await cg.templatable(config[CONF_REPEAT], args, cg.bool_)
+        cg.add(var.set_repeat(repeat))
+    return var
@@ -11,140 +11,894 @@ static const char *TAG = "max3000";
 #define PANEL_HEIGHT 16
 #define PANEL_WIDTH 28
 
+// Minimum time between transition steps, in milliseconds
+#define TRANSITION_STEP_DELAY 5
+
+// Pulse calibration: how long each fill or clear stays on show, and how the pulse shrinks
+#define CALIBRATION_PHASE_MS 2000
+#define CALIBRATION_STEP_US 10
+#define CALIBRATION_MIN_US 20
+
+// Frame packets decoded per loop(), so a flood can't keep the loop from returning
+#define FRAME_PACKETS_PER_LOOP 8
+
 // Constructor
 MAX3000::MAX3000(int displaysWide, int displaysHigh) : displaysWide_(displaysWide), displaysHigh_(displaysHigh) {
   dWidth = displaysWide * PANEL_WIDTH;
   dHeight = displaysHigh * PANEL_HEIGHT;
 
   // Amount of bytes in memory that the buffer needs to be
-  int bufferSize = dWidth *((dHeight + 7) / 8);
+  size_t bufferSize = (size_t) dWidth * ((dHeight + 7) / 8);
 
   // Set up the memory, maybe it will work this time.
   before = new uint8_t[bufferSize];
   after = new uint8_t[bufferSize];
+  composite_ = new uint8_t[bufferSize];
 }
 
 void MAX3000::setup() {
   ESP_LOGCONFIG(TAG, "Setting up SPI MAX3000...");
 
-  // Set up the pins
-  clk_pin_->setup();
-  mosi_pin_->setup();
+  // Set up the pins. Clock and data belong to the SPI bus when hardware SPI is used.
+  if (clk_pin_ != nullptr) clk_pin_->setup();
+  if (mosi_pin_ != nullptr) mosi_pin_->setup();
   col_pin_->setup();
   row_pin_->setup();
   pulse_pin_->setup();
   latch_pin_->setup();
   reset_pin_->setup();
+  for (const MAX3000_Chain &chain : chains_) {
+    for (GPIOPin *pin : {chain.mosi_pin, chain.sclk_pin, chain.lat_pin, chain.pulse_pin, chain.col_pin, chain.row_pin}) {
+      if (pin != nullptr) pin->setup();
+    }
+  }
 
   // Initialize our copy of the display
-  fDots = new MAX3000_Display(MAX3000_Config(dWidth, dHeight,
+  MAX3000_Config config(dWidth, dHeight,
     mosi_pin_, clk_pin_, latch_pin_, reset_pin_,
-    pulse_pin_, col_pin_, row_pin_));
+    pulse_pin_, col_pin_, row_pin_);
+#ifdef USE_SPI
+  if (hardware_spi_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "Using hardware SPI for the shift registers");
+    hardware_spi_->set_data_rate(spi_data_rate_);
+    config = MAX3000_Config(dWidth, dHeight, hardware_spi_,
+      latch_pin_, reset_pin_, pulse_pin_, col_pin_, row_pin_);
+  }
+#endif
+  config.boardOrder = board_order_;
+  config.fastGpio = fast_gpio_;
+  config.shiftClockHz = shift_clock_rate_;
+  for (const MAX3000_Chain &chain : chains_) {
+    config.addChain(chain);
+  }
+  fDots = new MAX3000_Display(config);
 
   // Set up the memory for the buffers.  If we do it in the Begin function, it crashes.
   ESP_LOGCONFIG(TAG, "Allocating memory for buffer in display");
 
-  // Initialize the display
-  fDots->begin();
+  // Initialize the display. It refuses chains or SPI it can't drive, before any buffer is allocated.
+  if (!fDots->begin()) {
+    ESP_LOGE(TAG, "The display couldn't be set up with this configuration");
+    this->mark_failed();
+    return;
+  }
+  if (batch_draw_) {
+    batch_.begin(fDots, dWidth, dHeight, 256);
+  }
   fDots->setDissolveEnable(dissolveEnabled);
+  fDots->setFlipBudget(flip_budget_);
+  fDots->setFlipOrder(flip_order_);
+  for (const PriorityRegion &region : priority_regions_) {
+    apply_priority_region_(region);
+  }
+  fDots->setPulseDurationUs(pulse_duration_us_);
+  for (int board : rotated_boards_) {
+    fDots->setBoardRotation(board, 2);
+  }
+  for (const BoardPulse &pulse : board_pulses_) {
+    fDots->setBoardPulseDurationUs(pulse.board, pulse.set_us, pulse.clear_us);
+  }
 
   // Clear it and get it ready
   fDots->clearDisplay();
   fDots->display();
 
+#ifdef USE_ESP32
+  if (driver_task_) {
+    // The YAML checks the core against the variant, a lambda calling set_driver_task_core() doesn't
+    if (driver_task_core_ >= portNUM_PROCESSORS) {
+      ESP_LOGW(TAG, "There's no core %d, running the driver task on core %d", driver_task_core_,
+               portNUM_PROCESSORS - 1);
+      driver_task_core_ = portNUM_PROCESSORS - 1;
+    }
+    // From here on the task owns the pulse engine, and drawing must not touch its state.
+    ESP_LOGCONFIG(TAG, "Starting driver task on core %d", driver_task_core_);
+    fDots->setDirtyTracking(false);
+    handoff_.begin(dWidth * ((dHeight + 7) / 8));
+    xTaskCreatePinnedToCore(driver_task_loop_, "max3000", 4096, this, 1, &driver_task_handle_, driver_task_core_);
+  }
+#endif
+
+#ifdef USE_MAX3000_FRAME_SINK
+  if (frame_port_ != 0) {
+    setup_frame_sink_();
+  }
+#endif
+
   ESP_LOGCONFIG(TAG, "Display Ready");
 }
 
+#ifdef USE_SPI
+void MAX3000::set_spi_parent(spi::SPIComponent *parent) {
+  hardware_spi_ = new MAX3000HardwareSPI();
+  hardware_spi_->set_spi_parent(parent);
+}
+#endif
+
+void MAX3000::loop() {
+  if (this->is_failed()) {
+    return;
+  }
+  if (calibrating_) {
+    if (millis() - last_calibration_step_ >= CALIBRATION_PHASE_MS && display_idle_()) {
+      step_calibration_();
+    }
+    return;
+  }
+
+#ifdef USE_MAX3000_FRAME_SINK
+  receive_frames_();
+#endif
+
+  if (scrolling_ && display_idle_() && millis() - last_scroll_step_ >= scroll_interval_ms_) {
+    step_scroll_();
+  }
+
+  // Show the next animation frame once the previous one has had its time
+  if (animation_ != nullptr && display_idle_() && millis() - animation_frame_start_ >= animation_frame_ms_) {
+    step_animation_();
+  }
+
+  // Move the transition along once the previous step is on the display
+  if (activeTransition_ != nullptr && display_idle_() && millis() - lastTransitionStep_ >= TRANSITION_STEP_DELAY) {
+    step_transition_();
+  }
+
+#ifdef USE_ESP32
+  // The driver task owns the pulse engine and finishes its frames by itself, so its state
+  // isn't even read from here
+  if (driver_task_) {
+    return;
+  }
+#endif
+
+  // Frames over the flip budget are finished from here too
+  if (!(incremental_ || flip_budget_ != 0) || !fDots->displayPending()) {
+    return;
+  }
+
+  // Flip as many dots as fit in one slice, then give the rest of the system a turn.
+  fDots->displayStep(slice_time_us_);
+
+  if (!fDots->displayPending()) {
+    high_freq_.stop();
+    log_frame_stats_();
+  }
+}
+
+#ifdef USE_ESP32
+void MAX3000::driver_task_loop_(void *param) {
+  MAX3000 *self = static_cast<MAX3000 *>(param);
+
+  for (;;) {
+    // Always switch to the newest frame. Dots already flipped for an older
+    // one are kept, and the rest of it is dropped.
+    if (self->handoff_.pending()) {
+      self->driver_idle_ = false;
+      const uint8_t *frame = self->handoff_.acquire();
+      if (frame != nullptr) {
+        self->fDots->beginFrame(frame);
+      }
+    }
+
+    if (self->fDots->displayPending()) {
+      self->fDots->displayStep(self->slice_time_us_);
+      // Let lower priority tasks on this core run, so the watchdog stays fed.
+      vTaskDelay(1);
+      continue;
+    }
+
+    // Sleep until update() publishes another frame
+    self->driver_idle_ = true;
+    if (!self->handoff_.pending()) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+}
+#endif
+
 void MAX3000::set_dissolve(bool dissolve) {
   dissolveEnabled = dissolve;
 }
 
 void MAX3000::dump_config(){
     ESP_LOGCONFIG(TAG, "MAX3000 SPI");
+    static const char *const ORDER_NAMES[] = {"row major", "row major bounce", "column major", "column major bounce"};
+    ESP_LOGCONFIG(TAG, "  Board order: %s", ORDER_NAMES[board_order_ & 3]);
+    for (int board : rotated_boards_) {
+      ESP_LOGCONFIG(TAG, "  Board %d upside down", board);
+    }
+    ESP_LOGCONFIG(TAG, "  Pulse duration: %uus", pulse_duration_us_);
+    for (const BoardPulse &pulse : board_pulses_) {
+      ESP_LOGCONFIG(TAG, "  Board %d pulses: set %uus, clear %uus", pulse.board, pulse.set_us, pulse.clear_us);
+    }
+    for (const Animation &animation : animations_) {
+      ESP_LOGCONFIG(TAG, "  Animation '%s': %u bytes", animation.name.c_str(), (unsigned) animation.size);
+    }
+    for (size_t i = 0; i < chains_.size(); i++) {
+      ESP_LOGCONFIG(TAG, "  Extra chain %u: %u boards", (unsigned) i + 1, (unsigned) chains_[i].numBoards);
+    }
+    if (flip_budget_ != 0) {
+      ESP_LOGCONFIG(TAG, "  Flip budget: %u dots", flip_budget_);
+    }
+    if (flip_order_ == MAX3000_FLIP_OLDEST) {
+      ESP_LOGCONFIG(TAG, "  Oldest dots first");
+    }
+    for (const PriorityRegion &region : priority_regions_) {
+      ESP_LOGCONFIG(TAG, "  Priority region: %dx%d at %d,%d", region.width, region.height, region.x, region.y);
+    }
+    if (fast_gpio_) {
+      ESP_LOGCONFIG(TAG, "  Fast GPIO");
+    }
+    if (clk_pin_ != nullptr) {
+      ESP_LOGCONFIG(TAG, "  Shift clock: %u Hz", shift_clock_rate_);
+    }
+#ifdef USE_MAX3000_FRAME_SINK
+    if (frame_port_ != 0) {
+      ESP_LOGCONFIG(TAG, "  Frame port: %u, timeout %ums", frame_port_, frame_timeout_ms_);
+    }
+#endif
+    if (batch_draw_) {
+      ESP_LOGCONFIG(TAG, "  Batched drawing");
+    }
+    if (pageTransition_ != nullptr) {
+      ESP_LOGCONFIG(TAG, "  Page transition: %s", pageTransition_->name());
+    }
+
+    if (incremental_) {
+      ESP_LOGCONFIG(TAG, "  Incremental, %uus per slice", slice_time_us_);
+    }
+#ifdef USE_ESP32
+    if (driver_task_) {
+      ESP_LOGCONFIG(TAG, "  Driver task on core %d, %uus per slice", driver_task_core_, slice_time_us_);
+    }
+#endif
 }
 
 // no idea what this HOT does
 void HOT MAX3000::draw_absolute_pixel_internal(int x, int y, Color color) {
-    fDots->drawPixel(x, y, color.is_on());
+    if (capturing_strip_) {
+      // Drawing the text of a scroll into its strip, laid out like the buffer
+      if (x >= 0 && x < scroll_width_ && y >= 0 && y < dHeight && color.is_on()) {
+        scroll_strip_[x + (y / 8) * scroll_width_] |= 1 << (y & 7);
+      }
+      return;
+    }
+    if (batching_) {
+      batch_.addPixel(x, y, color.is_on());
+      return;
+    }
+    // ESPHome has already rotated the pixel, and the library always draws at rotation 0 here
+    if (color.is_on()) {
+      fDots->setPixelRot0(x, y);
+    } else {
+      fDots->clearPixelRot0(x, y);
+    }
 }
 
 void MAX3000::update() {
+    // The calibration pattern owns the display until it's done
+    if (this->is_failed() || calibrating_) {
+      return;
+    }
+
+    // A playing animation or scroll owns the display
+    if (animation_ != nullptr || scrolling_) {
+      return;
+    }
+
+#ifdef USE_MAX3000_FRAME_SINK
+    // Streamed frames own the display until they stop arriving
+    if (streaming_) {
+      if (millis() - last_frame_packet_ < frame_timeout_ms_) {
+        return;
+      }
+      streaming_ = false;
+      ESP_LOGD(TAG, "Frame stream stopped after %u frames, %u rejected", frame_packets_, rejected_packets_);
+    }
+#endif
+    // The page is drawn over whatever frame the next delta would be based on
+    fDots->invalidateFramePackets();
+
+    // Changing pages plays the page transition, but not when showing the first page
+    if (this->page_ != lastPage_) {
+      if (lastPage_ != nullptr && pageTransition_ != nullptr && nextTransition == nullptr) {
+        nextTransition = pageTransition_;
+      }
+      lastPage_ = this->page_;
+    }
 
     // If transition is turned on...
-    if (nextTransition > 0) {
+    if (nextTransition != nullptr) {
       // Copy the current look into a buffer, this will be the 'before' of the transition.
+      // If another transition is still running, this picks up from wherever it got to.
       fDots->copyBuffer(before);
     }
 
     // Without this one do_update call, NONE of the ESPHome drawing functions work.
     // This seems to be what causes ESPHome to actually issue all the draw calls to the draw_absolute_pixel above.
-    do_update_();
+    render_frame_();
 
-    if (nextTransition > 0) {
+    if (nextTransition != nullptr) {
         // Copy the after into a buffer
         fDots->copyBuffer(after);
 
-        doTransition(nextTransition);
-        nextTransition = 0;
+        start_transition_(nextTransition);
+        nextTransition = nullptr;
+        return;
+    }
+
+    if (activeTransition_ != nullptr) {
+        // A newer frame arrived during the transition. Keep going, but towards the new frame.
+        fDots->copyBuffer(after);
+        compose_transition_(transitionStep_);
+        fDots->replaceBuffer(composite_);
     }
 
     // Send the pixels to the display
+    commit_frame_();
+}
+
+void MAX3000::commit_frame_() {
+#ifdef USE_ESP32
+    if (driver_task_) {
+      // Hand a copy to the driver task, replacing any frame it hasn't started yet
+      fDots->copyBuffer(handoff_.writeBuffer());
+      handoff_.publish();
+      xTaskNotifyGive(driver_task_handle_);
+      return;
+    }
+#endif
+
+    if (incremental_) {
+      // Pulses are sent from loop(). Any dots still pending from the previous
+      // frame are merged into this one.
+      fDots->beginFrame();
+      if (fDots->displayPending()) {
+        high_freq_.start();
+      }
+      return;
+    }
+
     fDots->display();
+    if (fDots->displayPending()) {
+      // Over the flip budget, loop() flips the rest
+      high_freq_.start();
+      return;
+    }
+    log_frame_stats_();
+}
+
+void MAX3000::render_frame_() {
+    if (!batch_draw_) {
+      do_update_();
+      return;
+    }
+
+    // Record everything the page draws, then write it all at once
+    batch_.reset();
+    batching_ = true;
+    do_update_();
+    batching_ = false;
+    batch_.commit();
+
+    const MAX3000_DrawStats &stats = batch_.getStats();
+    ESP_LOGV(TAG, "Draw: %u ops, %u pixels drawn, %u written (overdraw %.2f), %uus", stats.ops, stats.pixelsDrawn,
+             stats.pixelsWritten, stats.pixelsWritten ? (float) stats.pixelsDrawn / stats.pixelsWritten : 0.0f,
+             stats.rasterizeUs);
+}
+
+void MAX3000::log_frame_stats_() {
+    const MAX3000_Stats &stats = fDots->getStats();
+    if (stats.dotFlips == 0) {
+      return;
+    }
+    ESP_LOGV(TAG, "Frame: %u flips, %u pulses, %u shift pushes (%u skipped), %u GPIO writes, %uus (model %uus)",
+             stats.dotFlips, stats.pulses, stats.shiftPushes, stats.skippedPushes, stats.gpioWrites, stats.elapsedUs,
+             stats.modelUs);
+}
+
+bool MAX3000::display_idle_() {
+#ifdef USE_ESP32
+    if (driver_task_) {
+      return !handoff_.pending() && driver_idle_;
+    }
+#endif
+
+    return !fDots->displayPending();
 }
 
 void MAX3000::transitionOnNextUpdate(int transition) {
-    nextTransition = transition;
+    // Transition 1 is the horizontal wipe and 2 the diagonal wipe, followed by the rest of the registry
+    nextTransition = MAX3000_findTransition(transition);
 }
 
-void MAX3000::doTransition(int transition) {
+void MAX3000::transitionOnNextUpdate(const std::string &name) {
+    nextTransition = MAX3000_findTransition(name.c_str());
+    if (nextTransition == nullptr) {
+      ESP_LOGW(TAG, "Unknown transition '%s'", name.c_str());
+    }
+}
 
-    // Put the BEFORE back on the display.
-    fDots->replaceBuffer(before);
+void MAX3000::set_page_transition(const std::string &name) {
+    pageTransition_ = MAX3000_findTransition(name.c_str());
+}
 
-    switch (transition) {
-      case 1: // Transition 1: A simple horizontal wipe from left to right
-        for (int x = 0; x < dWidth; x++) {
+void MAX3000::cancelTransition() {
+    if (activeTransition_ == nullptr) {
+      return;
+    }
+    activeTransition_ = nullptr;
+    transition_high_freq_.stop();
+    fDots->replaceBuffer(after);
+    commit_frame_();
+}
 
-          // Draw the line top to bottom
-          for (int y = 0; y < dHeight; y++) {
-            // double thickness to make it more obvious
-            fDots->drawPixel(x, y, MAX3000_LIGHT);
-            fDots->drawPixel(x+1, y, MAX3000_LIGHT);
+void MAX3000::abort_transition_() {
+    // A running transition would keep drawing over whatever replaces it
+    activeTransition_ = nullptr;
+    transition_high_freq_.stop();
+}
 
-            // Draw the 'after' in the row behind the line
-            if (x > 0) {
-              fDots->drawPixel(x - 1, y, getPixel(after, x-1, y) ? MAX3000_LIGHT : MAX3000_DARK);
-            }
-          }
+MAX3000_TransitionCost MAX3000::estimateTransition(const std::string &name) {
+    MAX3000_TransitionCost cost{};
+    const MAX3000_Transition *transition = MAX3000_findTransition(name.c_str());
+    if (transition == nullptr) {
+      ESP_LOGW(TAG, "Unknown transition '%s'", name.c_str());
+      return cost;
+    }
 
-          // Draw it as fast as possible.
-          fDots->display();
-          delay(5);
-        }
+    // Worst case content change: every dot of the current frame flips
+    size_t bufferSize = (size_t) dWidth * ((dHeight + 7) / 8);
+    uint8_t *from = new uint8_t[bufferSize];
+    uint8_t *to = new uint8_t[bufferSize];
+    fDots->copyBuffer(from);
+    for (size_t i = 0; i < bufferSize; i++) {
+      to[i] = ~from[i];
+    }
+    cost = estimate_transition_(transition, from, to);
+    delete[] from;
+    delete[] to;
+    return cost;
+}
+
+MAX3000_TransitionCost MAX3000::estimate_transition_(const MAX3000_Transition *transition, const uint8_t *from,
+                                                     const uint8_t *to) {
+    size_t bufferSize = (size_t) dWidth * ((dHeight + 7) / 8);
+    uint8_t *scratch = new uint8_t[bufferSize];
+    MAX3000_TransitionFrames frames = {from, to, scratch, (int16_t) dWidth, (int16_t) dHeight};
+    MAX3000_TransitionCost cost = transition->estimateCost(frames, fDots->estimatePulseTimeUs(), TRANSITION_STEP_DELAY);
+    delete[] scratch;
+    return cost;
+}
+
+void MAX3000::start_transition_(const MAX3000_Transition *transition) {
+    activeTransition_ = transition;
+    MAX3000_TransitionFrames frames = {before, after, composite_, (int16_t) dWidth, (int16_t) dHeight};
+    transitionStep_ = transition->nextStep(-1, frames);
+
+    ESP_LOGD(TAG, "Transition '%s'", transition->name());
+
+    if (!compose_transition_(transitionStep_)) {
+      // Nothing to show, go straight to the new frame
+      activeTransition_ = nullptr;
+      commit_frame_();
+      return;
+    }
+
+    fDots->replaceBuffer(composite_);
+    commit_frame_();
+    lastTransitionStep_ = millis();
+    transition_high_freq_.start();
+}
+
+void MAX3000::step_transition_() {
+    MAX3000_TransitionFrames frames = {before, after, composite_, (int16_t) dWidth, (int16_t) dHeight};
+    transitionStep_ = activeTransition_->nextStep(transitionStep_, frames);
+    lastTransitionStep_ = millis();
+
+    if (compose_transition_(transitionStep_)) {
+      fDots->replaceBuffer(composite_);
+    } else {
+      // Finished, leave just the 'after' on the display
+      activeTransition_ = nullptr;
+      transition_high_freq_.stop();
+      fDots->replaceBuffer(after);
+    }
+    commit_frame_();
+}
+
+bool MAX3000::compose_transition_(int step) {
+    if (step >= activeTransition_->numSteps(dWidth, dHeight)) {
+      return false;
+    }
+
+    MAX3000_TransitionFrames frames = {before, after, composite_, (int16_t) dWidth, (int16_t) dHeight};
+    activeTransition_->compose(step, frames);
+    return true;
+}
+
+void MAX3000::start_scroll(const std::string &text, display::BaseFont *font, int y, float speed, bool repeat) {
+    if (!can_draw_direct_()) {
+      ESP_LOGW(TAG, "Scrolling needs the display unrotated and unclipped");
+      return;
+    }
+
+    int x1, y1, width, height;
+    this->get_text_bounds(0, y, text.c_str(), font, display::TextAlign::TOP_LEFT, &x1, &y1, &width, &height);
+    scroll_width_ = width;
+    scroll_strip_.assign((size_t) width * ((dHeight + 7) / 8), 0);
+
+    // Draw the text once, through the regular font code, into the strip
+    capturing_strip_ = true;
+    this->print(-x1, y, font, COLOR_ON, display::TextAlign::TOP_LEFT, text.c_str());
+    capturing_strip_ = false;
+
+    // A running transition or animation would draw over the text
+    abort_transition_();
+    stop_animation();
+
+    set_scroll_speed(speed);
+    scroll_repeat_ = repeat;
+    scroll_left_ = -dWidth;
+    last_scroll_step_ = millis() - scroll_interval_ms_;
+    scrolling_ = true;
+    scroll_high_freq_.start();
+}
+
+void MAX3000::stop_scroll() {
+    if (!scrolling_) {
+      return;
+    }
+    scrolling_ = false;
+    scroll_high_freq_.stop();
+    scroll_strip_.clear();
+    scroll_strip_.shrink_to_fit();
+}
 
+void MAX3000::set_scroll_speed(float speed) {
+    scroll_interval_ms_ = speed > 0 ? (uint32_t) (1000.0f / speed) : 0;
+}
+
+void MAX3000::step_scroll_() {
+    if (++scroll_left_ > scroll_width_) {
+      if (!scroll_repeat_) {
+        // The text has gone, leave the display blank until the pages take over
+        stop_scroll();
+        return;
+      }
+      scroll_left_ = 1 - dWidth;
+    }
+
+    last_scroll_step_ = millis();
+    fDots->copyWindow(scroll_strip_.data(), scroll_width_, scroll_left_);
+    fDots->invalidateFramePackets();
+    commit_frame_();
+}
+
+void MAX3000::add_priority_region(int x, int y, int width, int height) {
+    priority_regions_.push_back({x, y, width, height});
+    if (fDots != nullptr) {
+      apply_priority_region_(priority_regions_.back());
+    }
+}
+
+void MAX3000::apply_priority_region_(const PriorityRegion &region) {
+    // Regions are given in drawing coordinates, the library works on the unrotated buffer
+    switch (this->rotation_) {
+      case display::DISPLAY_ROTATION_90_DEGREES:
+        fDots->setPriorityRect(dWidth - region.y - region.height, region.x, region.height, region.width);
         break;
-      case 2: // Transition 2: A diagonal swipe.
-        for (int x = 0; x < dWidth + dHeight; x++) {
-
-          // Draw the line top to bottom
-          for (int y = 0; y < dHeight; y++) {
-            // double thickness to make it more obvious
-            fDots->drawPixel(x - y, y, MAX3000_LIGHT);
-            fDots->drawPixel(x - y + 1, y, MAX3000_LIGHT);
-
-            // Draw the 'after' in the row behind the line
-            if (x - y - 1 >= 0 && x - y - 1 < dWidth) {
-              fDots->drawPixel(x - y - 1, y, getPixel(after, x-y-1, y) ? MAX3000_LIGHT : MAX3000_DARK);
-            }
-          }
+      case display::DISPLAY_ROTATION_180_DEGREES:
+        fDots->setPriorityRect(dWidth - region.x - region.width, dHeight - region.y - region.height, region.width,
+                               region.height);
+        break;
+      case display::DISPLAY_ROTATION_270_DEGREES:
+        fDots->setPriorityRect(region.y, dHeight - region.x - region.width, region.height, region.width);
+        break;
+      default:
+        fDots->setPriorityRect(region.x, region.y, region.width, region.height);
+        break;
+    }
+}
 
-          // Draw it as fast as possible.
-          fDots->display();
-          delay(5);
-        }
+void MAX3000::clear_priority_regions() {
+    priority_regions_.clear();
+    if (fDots != nullptr) {
+      fDots->clearPriorityRects();
+    }
+}
+
+void MAX3000::add_animation(const std::string &name, const uint8_t *data, size_t size) {
+    animations_.push_back({name, data, size});
+}
+
+void MAX3000::play_animation(const std::string &name, bool repeat) {
+    for (const Animation &animation : animations_) {
+      if (animation.name == name) {
+        abort_transition_();
+        stop_scroll();
+        animation_ = &animation;
+        animation_repeat_ = repeat;
+        animation_offset_ = 0;
+        animation_frame_ms_ = 0;
+        animation_high_freq_.start();
+        return;
+      }
+    }
+    ESP_LOGW(TAG, "Unknown animation '%s'", name.c_str());
+}
 
+void MAX3000::stop_animation() {
+    if (animation_ == nullptr) {
+      return;
+    }
+    animation_ = nullptr;
+    animation_high_freq_.stop();
+}
+
+void MAX3000::step_animation_() {
+    if (animation_offset_ >= animation_->size) {
+      if (!animation_repeat_) {
+        stop_animation();
+        return;
+      }
+      // The first frame is always a whole one, so it can follow any other
+      animation_offset_ = 0;
+    }
+
+    // Frames live in flash, and are small enough to copy out before decoding
+    const uint8_t *frame = animation_->data + animation_offset_;
+    uint16_t length = progmem_read_byte(frame) | (progmem_read_byte(frame + 1) << 8);
+    uint16_t duration = progmem_read_byte(frame + 2) | (progmem_read_byte(frame + 3) << 8);
+    animation_packet_.resize(length);
+    for (uint16_t i = 0; i < length; i++) {
+      animation_packet_[i] = progmem_read_byte(frame + 4 + i);
+    }
+    if (!fDots->applyFramePacket(animation_packet_.data(), length)) {
+      ESP_LOGW(TAG, "Animation '%s' doesn't fit this display", animation_->name.c_str());
+      stop_animation();
+      return;
+    }
+
+    animation_offset_ += 4 + length;
+    animation_frame_start_ = millis();
+    animation_frame_ms_ = duration;
+    commit_frame_();
+}
+
+#ifdef USE_MAX3000_FRAME_SINK
+void MAX3000::setup_frame_sink_() {
+    // Big enough for the longest valid packet, a delta with every byte changed, plus one
+    // byte so that anything longer shows up as cut short
+    size_t bufferSize = (size_t) dWidth * ((dHeight + 7) / 8);
+    frame_packet_.resize(MAX3000_PACKET_HEADER + bufferSize + (bufferSize + 127) / 128 + 1);
+
+    frame_socket_ = socket::socket_ip(SOCK_DGRAM, IPPROTO_UDP);
+    if (frame_socket_ == nullptr) {
+      ESP_LOGE(TAG, "Could not create the frame socket");
+      return;
+    }
+    frame_socket_->setblocking(false);
+    struct sockaddr_storage address;
+    socklen_t length = socket::set_sockaddr_any((struct sockaddr *) &address, sizeof(address), frame_port_);
+    if (frame_socket_->bind((struct sockaddr *) &address, length) != 0) {
+      ESP_LOGE(TAG, "Could not listen for frames on port %u", frame_port_);
+      frame_socket_ = nullptr;
+      return;
+    }
+    ESP_LOGCONFIG(TAG, "Listening for frames on UDP port %u", frame_port_);
+}
+
+void MAX3000::receive_frames_() {
+    if (frame_socket_ == nullptr) {
+      return;
+    }
+
+    // Decode what's queued up, a few packets at a time, then show only where that left the buffer
+    bool received = false;
+    for (int i = 0; i < FRAME_PACKETS_PER_LOOP; i++) {
+      ssize_t length = frame_socket_->read(frame_packet_.data(), frame_packet_.size());
+      if (length < 0) {
         break;
+      }
+      if ((size_t) length < frame_packet_.size() && fDots->applyFramePacket(frame_packet_.data(), length)) {
+        frame_packets_++;
+        received = true;
+      } else {
+        rejected_packets_++;
+      }
+    }
+    if (!received) {
+      return;
+    }
+
+    if (!streaming_) {
+      ESP_LOGD(TAG, "Frame stream started");
+      streaming_ = true;
+    }
+    stop_animation();
+    stop_scroll();
+    last_frame_packet_ = millis();
+
+    abort_transition_();
+    commit_frame_();
+}
+#endif
+
+void MAX3000::add_board_pulse_duration(int board, uint32_t set_us, uint32_t clear_us) {
+    for (BoardPulse &pulse : board_pulses_) {
+      if (pulse.board == board) {
+        pulse.set_us = set_us;
+        pulse.clear_us = clear_us;
+        return;
+      }
+    }
+    board_pulses_.push_back({board, (uint16_t) set_us, (uint16_t) clear_us});
+}
+
+void MAX3000::start_pulse_calibration() {
+#ifdef USE_ESP32
+    if (driver_task_) {
+      ESP_LOGW(TAG, "Pulse calibration isn't available with the driver task");
+      return;
     }
+#endif
+    cancelTransition();
+    // Each fill has to reach every dot before the next one starts
+    fDots->setFlipBudget(0);
+    calibrating_ = true;
+    ESP_LOGI(TAG, "Starting pulse calibration. Mark a failure as soon as dots stop flipping.");
+    start_calibration_board_(0);
+}
+
+void MAX3000::stop_pulse_calibration() {
+    if (!calibrating_) {
+      return;
+    }
+    calibrating_ = false;
+    fDots->setFlipBudget(flip_budget_);
+
+    // The board under test keeps what was measured so far, and its configured durations otherwise
+    BoardPulse configured = {calibration_board_, (uint16_t) pulse_duration_us_, (uint16_t) pulse_duration_us_};
+    for (const BoardPulse &pulse : board_pulses_) {
+      if (pulse.board == calibration_board_) {
+        configured = pulse;
+      }
+    }
+    if (!calibration_set_done_) {
+      calibration_set_us_ = configured.set_us;
+    }
+    if (!calibration_clear_done_) {
+      calibration_clear_us_ = configured.clear_us;
+    }
+    save_calibration_board_();
+
+    // Print the results in a form that can go straight into the configuration
+    ESP_LOGI(TAG, "Pulse calibration done:");
+    ESP_LOGI(TAG, "    board_pulse_durations:");
+    for (const BoardPulse &pulse : board_pulses_) {
+      ESP_LOGI(TAG, "      - board: %d", pulse.board);
+      ESP_LOGI(TAG, "        set: %uus", pulse.set_us);
+      ESP_LOGI(TAG, "        clear: %uus", pulse.clear_us);
+    }
+
+    fDots->clearDisplay();
+    fDots->display();
+    update();
+}
+
+void MAX3000::mark_calibration_failure() {
+    if (!calibrating_) {
+      return;
+    }
+
+    // Dots failed on whatever is showing, so the previous, longer pulse was the last good one
+    if (calibration_filled_ && !calibration_set_done_) {
+      calibration_set_us_ = std::min<uint32_t>(calibration_set_us_ + CALIBRATION_STEP_US, pulse_duration_us_);
+      calibration_set_done_ = true;
+      ESP_LOGI(TAG, "Board %d: set pulses fail below %uus", calibration_board_, calibration_set_us_);
+    } else if (!calibration_filled_ && !calibration_clear_done_) {
+      calibration_clear_us_ = std::min<uint32_t>(calibration_clear_us_ + CALIBRATION_STEP_US, pulse_duration_us_);
+      calibration_clear_done_ = true;
+      ESP_LOGI(TAG, "Board %d: clear pulses fail below %uus", calibration_board_, calibration_clear_us_);
+    }
+
+    if (calibration_set_done_ && calibration_clear_done_) {
+      finish_calibration_board_();
+    }
+}
+
+void MAX3000::start_calibration_board_(int board) {
+    calibration_board_ = board;
+    calibration_set_us_ = pulse_duration_us_;
+    calibration_clear_us_ = pulse_duration_us_;
+    calibration_set_done_ = false;
+    calibration_clear_done_ = false;
+    calibration_filled_ = false;
+    calibration_cleared_ = false;
+
+    // Only the board under test flips, so every pulse runs at its durations
+    fDots->clearDisplay();
+    fDots->display();
+    last_calibration_step_ = millis();
+}
+
+void MAX3000::step_calibration_() {
+    int16_t boardX, boardY;
+    fDots->getBoardPosition(calibration_board_, boardX, boardY);
+
+    // A round fills the board with set pulses and clears it with clear pulses, then both
+    // shrink by one step unless they already failed. They shrink only when the next fill is
+    // drawn, so a failure marked on the clear still sees the duration that was shown.
+    if (!calibration_filled_) {
+      if (calibration_cleared_) {
+        if (!calibration_set_done_) {
+          if (calibration_set_us_ - CALIBRATION_STEP_US < CALIBRATION_MIN_US) {
+            calibration_set_done_ = true;
+          } else {
+            calibration_set_us_ -= CALIBRATION_STEP_US;
+          }
+        }
+        if (!calibration_clear_done_) {
+          if (calibration_clear_us_ - CALIBRATION_STEP_US < CALIBRATION_MIN_US) {
+            calibration_clear_done_ = true;
+          } else {
+            calibration_clear_us_ -= CALIBRATION_STEP_US;
+          }
+        }
+        if (calibration_set_done_ && calibration_clear_done_) {
+          finish_calibration_board_();
+          return;
+        }
+      }
+      if (!calibration_set_done_ && !calibration_clear_done_) {
+        ESP_LOGD(TAG, "Board %d: set %uus, clear %uus", calibration_board_, calibration_set_us_, calibration_clear_us_);
+      }
+      fDots->setBoardPulseDurationUs(calibration_board_, calibration_set_us_, calibration_clear_us_);
+      fDots->fillRect(boardX, boardY, PANEL_WIDTH, PANEL_HEIGHT, MAX3000_LIGHT);
+    } else {
+      fDots->fillRect(boardX, boardY, PANEL_WIDTH, PANEL_HEIGHT, MAX3000_DARK);
+      calibration_cleared_ = true;
+    }
+    fDots->display();
+    last_calibration_step_ = millis();
+    calibration_filled_ = !calibration_filled_;
+}
+
+void MAX3000::finish_calibration_board_() {
+    if (calibration_board_ + 1 < displaysWide_ * displaysHigh_) {
+      save_calibration_board_();
+      start_calibration_board_(calibration_board_ + 1);
+    } else {
+      stop_pulse_calibration();
+    }
+}
+
+void MAX3000::save_calibration_board_() {
+    ESP_LOGI(TAG, "Board %d: set %uus, clear %uus", calibration_board_, calibration_set_us_, calibration_clear_us_);
+    add_board_pulse_duration(calibration_board_, calibration_set_us_, calibration_clear_us_);
+    fDots->setBoardPulseDurationUs(calibration_board_, calibration_set_us_, calibration_clear_us_);
 }
 
 bool MAX3000::getPixel(uint8_t *buffer, int16_t x, int16_t y) {
@@ -156,10 +910,62 @@ bool MAX3000::getPixel(uint8_t *buffer, int16_t x, int16_t y) {
 
 void MAX3000::fill(Color color) {
     // Fill it with one color
-    for (int x = 0; x < dWidth; x++) {
-        for (int y = 0; y < dHeight; y++) {
-            fDots->drawPixel(x, y, color.is_on());
+    if (batching_) {
+      batch_.addRect(0, 0, dWidth, dHeight, color.is_on());
+      return;
+    }
+    fDots->fillScreen(color.is_on() ? MAX3000_LIGHT : MAX3000_DARK);
+}
+
+void MAX3000::fill_rect(int x, int y, int width, int height, Color color) {
+    if (!can_draw_direct_()) {
+      this->filled_rectangle(x, y, width, height, color);
+      return;
+    }
+    if (batching_) {
+      batch_.addRect(x, y, width, height, color.is_on());
+      return;
+    }
+    fDots->fillRect(x, y, width, height, color.is_on() ? MAX3000_LIGHT : MAX3000_DARK);
+}
+
+void MAX3000::horizontal_span(int x, int y, int width, Color color) {
+    if (!can_draw_direct_()) {
+      this->horizontal_line(x, y, width, color);
+      return;
+    }
+    if (batching_) {
+      batch_.addRect(x, y, width, 1, color.is_on());
+      return;
+    }
+    fDots->drawFastHLine(x, y, width, color.is_on() ? MAX3000_LIGHT : MAX3000_DARK);
+}
+
+void MAX3000::vertical_span(int x, int y, int height, Color color) {
+    if (!can_draw_direct_()) {
+      this->vertical_line(x, y, height, color);
+      return;
+    }
+    if (batching_) {
+      batch_.addRect(x, y, 1, height, color.is_on());
+      return;
+    }
+    fDots->drawFastVLine(x, y, height, color.is_on() ? MAX3000_LIGHT : MAX3000_DARK);
+}
+
+void MAX3000::blit(int x, int y, const uint8_t *bitmap, int width, int height, Color color) {
+    // While batching, the pixels below are merged into spans anyway
+    if (can_draw_direct_() && !batching_) {
+      fDots->drawBitmap(x, y, bitmap, width, height, color.is_on() ? MAX3000_LIGHT : MAX3000_DARK);
+      return;
+    }
+    int byteWidth = (width + 7) / 8;
+    for (int j = 0; j < height; j++) {
+      for (int i = 0; i < width; i++) {
+        if (bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7))) {
+          this->draw_pixel_at(x + i, y + j, color);
         }
+      }
     }
 }
 
@@ -1,25 +1,124 @@
 #pragma once
 
+#include "esphome/core/automation.h"
 #include "esphome/core/component.h"
 #include "esphome/core/hal.h"
 #include "esphome/components/display/display_buffer.h"
 #include "MAX3000_Lib.h"
+#include "MAX3000_Transitions.h"
+
+#include <vector>
+
+#ifdef USE_SPI
+#include "esphome/components/spi/spi.h"
+#endif
+
+#ifdef USE_MAX3000_FRAME_SINK
+#include "esphome/components/socket/socket.h"
+#include <memory>
+#endif
+
+#ifdef USE_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
 
 namespace esphome {
 namespace max3000 {
 
+#ifdef USE_SPI
+// Hardware SPI backend for the shift register chain, used when spi_id is set in the yaml
+class MAX3000HardwareSPI : public MAX3000_SPI,
+                           public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST, spi::CLOCK_POLARITY_LOW,
+                                                 spi::CLOCK_PHASE_LEADING, spi::DATA_RATE_4MHZ> {
+ public:
+  void begin() override { this->spi_setup(); }
+  void transfer(const uint8_t *data, size_t length) override {
+    this->enable();
+    this->write_array(data, length);
+    this->disable();
+  }
+};
+#endif
+
 class MAX3000 : public PollingComponent, public display::DisplayBuffer {
  public:
   MAX3000(int displaysWide, int displaysHigh);
 
   void setup() override;
+  void loop() override;
   void dump_config() override;
 
   void update() override;
   void fill(Color color) override;
 
-  // Cause the next update to be drawn with a transition first
+  // Bulk drawing that writes whole buffer bytes instead of going pixel by pixel.
+  // Falls back to the regular Display functions when the display is rotated or clipped.
+  void fill_rect(int x, int y, int width, int height, Color color = COLOR_ON);
+  void horizontal_span(int x, int y, int width, Color color = COLOR_ON);
+  void vertical_span(int x, int y, int height, Color color = COLOR_ON);
+  // Draw the set bits of a row-major, MSB-first bitmap
+  void blit(int x, int y, const uint8_t *bitmap, int width, int height, Color color = COLOR_ON);
+
+  // Cause the next update to be drawn with a transition first, chosen by number or by name
   void transitionOnNextUpdate(int transition);
+  void transitionOnNextUpdate(const std::string &name);
+
+  // Skip the rest of the running transition and show its final frame
+  void cancelTransition();
+  bool isTransitionActive() const { return activeTransition_ != nullptr; }
+
+  // Estimate the cost of a transition from the current frame to one where every dot has changed
+  MAX3000_TransitionCost estimateTransition(const std::string &name);
+
+  // Play a transition whenever the page changes
+  void set_page_transition(const std::string &name);
+
+  // Most dots flipped per update or loop() slice; the rest carry over and are flipped first
+  // in order. Priority regions are flipped before anything else, and the oldest order
+  // flips dots left over from earlier frames before newer ones.
+  void set_flip_budget(uint32_t flip_budget) { this->flip_budget_ = flip_budget; }
+  void set_flip_order(uint8_t flip_order) { this->flip_order_ = flip_order; }
+  void add_priority_region(int x, int y, int width, int height);
+  void clear_priority_regions();
+
+  // Animations converted from GIFs by display.py, stored as frame packets (see
+  // MAX3000_Base::applyFramePacket()). Each frame is its packet length and duration in
+  // milliseconds, both 16 bit little endian, followed by the packet.
+  void add_animation(const std::string &name, const uint8_t *data, size_t size);
+  // Play an animation in place of the pages, from its first frame. It keeps its last frame on
+  // show when it ends, and the pages are drawn again from the next update.
+  void play_animation(const std::string &name, bool repeat = true);
+  void stop_animation();
+  bool is_animation_playing() const { return animation_ != nullptr; }
+
+  // Scroll a line of text across the display. The text is drawn once into a strip, and each
+  // step copies the next window of it into the buffer. It comes in from the right edge and
+  // scrolls until it has left on the left, then starts over if repeat is set. Pages aren't
+  // drawn while it scrolls.
+  void start_scroll(const std::string &text, display::BaseFont *font, int y = 0, float speed = 30.0f,
+                    bool repeat = false);
+  void stop_scroll();
+  // Columns per second. Steps never come faster than the dots can flip.
+  void set_scroll_speed(float speed);
+  void set_scroll_repeat(bool repeat) { this->scroll_repeat_ = repeat; }
+  bool is_scrolling() const { return scrolling_; }
+
+  // How the boards are chained, one of the MAX3000_ORDER_* values, and which are mounted upside down
+  void set_board_order(uint8_t board_order) { this->board_order_ = board_order; }
+  void add_rotated_board(int board) { this->rotated_boards_.push_back(board); }
+
+  // Pulse duration for every board, and for single boards that need a different one
+  void set_pulse_duration(uint32_t duration_us) { this->pulse_duration_us_ = duration_us; }
+  void add_board_pulse_duration(int board, uint32_t set_us, uint32_t clear_us);
+
+  // Pulse calibration. Each board in turn is filled and cleared with shorter and shorter
+  // pulses. Call mark_calibration_failure() as soon as dots on it stop flipping; the
+  // pulse one step longer is kept as that board's shortest reliable one.
+  void start_pulse_calibration();
+  void mark_calibration_failure();
+  void stop_pulse_calibration();
+  bool is_calibrating() const { return calibrating_; }
 
   display::DisplayType get_display_type() override { return display::DisplayType::DISPLAY_TYPE_BINARY; }
 
@@ -32,9 +131,44 @@ class MAX3000 : public PollingComponent, public display::DisplayBuffer {
   void set_latch_pin(GPIOPin *latch_pin) { this->latch_pin_ = latch_pin; }
   void set_reset_pin(GPIOPin *reset_pin) { this->reset_pin_ = reset_pin; }
 
+  // Extra chain of boards shifted alongside the main one. Pins left null are shared with the main chain.
+  void add_chain(int num_boards, GPIOPin *mosi_pin, GPIOPin *clk_pin, GPIOPin *latch_pin, GPIOPin *pulse_pin,
+                 GPIOPin *col_pin, GPIOPin *row_pin) {
+    this->chains_.push_back({(size_t) num_boards, mosi_pin, clk_pin, latch_pin, pulse_pin, col_pin, row_pin});
+  }
+
+#ifdef USE_SPI
+  // Use a hardware SPI bus instead of bit-banging the clk and mosi pins
+  void set_spi_parent(spi::SPIComponent *parent);
+  void set_spi_data_rate(uint32_t data_rate) { this->spi_data_rate_ = data_rate; }
+#endif
+
   // Other optional functions
   void set_dissolve(bool dissolve);
 
+  // Flip dots from loop() in time slices instead of blocking in update()
+  void set_incremental(bool incremental) { this->incremental_ = incremental; }
+  // Record drawing during an update and write it to the buffer in one pass
+  void set_batch_draw(bool batch_draw) { this->batch_draw_ = batch_draw; }
+  void set_slice_time(uint32_t slice_time_us) { this->slice_time_us_ = slice_time_us; }
+  // Write the driver pins through the GPIO registers instead of GPIOPin
+  void set_fast_gpio(bool fast_gpio) { this->fast_gpio_ = fast_gpio; }
+  // Bit rate when bit-banging the shift registers
+  void set_shift_clock_rate(uint32_t shift_clock_rate) { this->shift_clock_rate_ = shift_clock_rate; }
+
+#ifdef USE_MAX3000_FRAME_SINK
+  // Show frame packets received on a UDP port, see MAX3000_Base::applyFramePacket(). Pages
+  // aren't drawn while packets keep arriving, until none has come for frame_timeout.
+  void set_frame_port(uint16_t port) { this->frame_port_ = port; }
+  void set_frame_timeout(uint32_t timeout_ms) { this->frame_timeout_ms_ = timeout_ms; }
+#endif
+
+#ifdef USE_ESP32
+  // Flip dots from a FreeRTOS task pinned to a core, update() only hands it finished frames
+  void set_driver_task(bool driver_task) { this->driver_task_ = driver_task; }
+  void set_driver_task_core(int core) { this->driver_task_core_ = core; }
+#endif
+
   float get_setup_priority() const override { return setup_priority::PROCESSOR; }
 
  protected:
@@ -53,6 +187,11 @@ class MAX3000 : public PollingComponent, public display::DisplayBuffer {
   GPIOPin *latch_pin_{nullptr};
   GPIOPin *reset_pin_{nullptr};
 
+#ifdef USE_SPI
+  MAX3000HardwareSPI *hardware_spi_{nullptr};
+  uint32_t spi_data_rate_{spi::DATA_RATE_4MHZ};
+#endif
+
   // Outputs for the pins
   void write_clk(bool state) { this->clk_pin_->digital_write(state); }
   void write_mosi(bool state) { this->mosi_pin_->digital_write(state); }
@@ -64,13 +203,133 @@ class MAX3000 : public PollingComponent, public display::DisplayBuffer {
 
   bool dissolveEnabled;
 
-  // Transition system
-  int nextTransition;
+  // Incremental mode: update() only starts a frame, and loop() flips the dots
+  bool incremental_{false};
+  bool batch_draw_{false};
+  bool batching_{false};
+  MAX3000_DrawBatch batch_;
+  uint32_t slice_time_us_{2000};
+  bool fast_gpio_{false};
+  uint32_t shift_clock_rate_{MAX3000_DEFAULT_SHIFT_CLOCK};
+  HighFrequencyLoopRequester high_freq_;
+
+#ifdef USE_ESP32
+  // Driver task mode: the task owns the pulse engine, frames reach it through the handoff
+  bool driver_task_{false};
+  int driver_task_core_{0};
+  TaskHandle_t driver_task_handle_{nullptr};
+  MAX3000_FrameHandoff handoff_;
+  std::atomic<bool> driver_idle_{true};
+  static void driver_task_loop_(void *param);
+#endif
+
+  struct BoardPulse {
+    int board;
+    uint16_t set_us;
+    uint16_t clear_us;
+  };
+  uint8_t board_order_{MAX3000_ORDER_ROW_MAJOR};
+  std::vector<int> rotated_boards_;
+  uint32_t pulse_duration_us_{150};
+  std::vector<BoardPulse> board_pulses_;
+  std::vector<MAX3000_Chain> chains_;
+
+  struct PriorityRegion {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+  uint32_t flip_budget_{0};
+  uint8_t flip_order_{MAX3000_FLIP_SPATIAL};
+  std::vector<PriorityRegion> priority_regions_;
+  void apply_priority_region_(const PriorityRegion &region);
+
+  bool scrolling_{false};
+  bool capturing_strip_{false};
+  bool scroll_repeat_{false};
+  std::vector<uint8_t> scroll_strip_;
+  int scroll_width_{0};
+  int32_t scroll_left_{0};
+  uint32_t scroll_interval_ms_{33};
+  uint32_t last_scroll_step_{0};
+  HighFrequencyLoopRequester scroll_high_freq_;
+  void step_scroll_();
+
+  struct Animation {
+    std::string name;
+    const uint8_t *data;
+    size_t size;
+  };
+  std::vector<Animation> animations_;
+  const Animation *animation_{nullptr};
+  bool animation_repeat_{false};
+  size_t animation_offset_{0};
+  uint32_t animation_frame_start_{0};
+  uint16_t animation_frame_ms_{0};
+  std::vector<uint8_t> animation_packet_;
+  HighFrequencyLoopRequester animation_high_freq_;
+  void step_animation_();
+
+#ifdef USE_MAX3000_FRAME_SINK
+  uint16_t frame_port_{0};
+  uint32_t frame_timeout_ms_{5000};
+  std::unique_ptr<socket::Socket> frame_socket_;
+  std::vector<uint8_t> frame_packet_;
+  uint32_t last_frame_packet_{0};
+  bool streaming_{false};
+  uint32_t frame_packets_{0};
+  uint32_t rejected_packets_{0};
+  void setup_frame_sink_();
+  void receive_frames_();
+#endif
+
+  // Pulse calibration state, stepped from loop()
+  bool calibrating_{false};
+  int calibration_board_{0};
+  uint16_t calibration_set_us_{0};
+  uint16_t calibration_clear_us_{0};
+  bool calibration_set_done_{false};
+  bool calibration_clear_done_{false};
+  bool calibration_filled_{false};
+  bool calibration_cleared_{false};
+  uint32_t last_calibration_step_{0};
+  void start_calibration_board_(int board);
+  void step_calibration_();
+  void finish_calibration_board_();
+  void save_calibration_board_();
+
+  // Send the buffer to the display, either right away, from loop() or from the driver task
+  void commit_frame_();
+
+  // Whether the last committed frame has been completely flipped
+  bool display_idle_();
+
+  // Transition system. Transitions are played one step per loop(), each step
+  // composited from the before and after frames.
+  const MAX3000_Transition *nextTransition{nullptr};
+  const MAX3000_Transition *activeTransition_{nullptr};
+  const MAX3000_Transition *pageTransition_{nullptr};
+  display::DisplayPage *lastPage_{nullptr};
+  int transitionStep_{0};
+  uint32_t lastTransitionStep_{0};
   uint8_t *before;
   uint8_t *after;
-  void doTransition(int transition);
+  uint8_t *composite_;
+  HighFrequencyLoopRequester transition_high_freq_;
+  void render_frame_();
+  bool can_draw_direct_() const { return this->rotation_ == display::DISPLAY_ROTATION_0_DEGREES && !this->is_clipping(); }
+  void start_transition_(const MAX3000_Transition *transition);
+  void step_transition_();
+  // Drop a running transition without showing its final frame, for content that replaces it
+  void abort_transition_();
+  bool compose_transition_(int step);
+  MAX3000_TransitionCost estimate_transition_(const MAX3000_Transition *transition, const uint8_t *from, const uint8_t *to);
   bool getPixel(uint8_t *buffer, int16_t x, int16_t y);
 
+  // Write the counters from the last display() call to the verbose log
+  void log_frame_stats_();
+
   // How many displays are in this configuration? 1 wide by 2 high? Or 2 wide by 1 high?
   int displaysWide_;
   int displaysHigh_;
@@ -86,5 +345,42 @@ class MAX3000 : public PollingComponent, public display::DisplayBuffer {
 
 
 
+template<typename... Ts> class ScrollStartAction : public Action<Ts...>, public Parented<MAX3000> {
+ public:
+  TEMPLATABLE_VALUE(std::string, text)
+  TEMPLATABLE_VALUE(int, y)
+  TEMPLATABLE_VALUE(float, speed)
+  TEMPLATABLE_VALUE(bool, repeat)
+  void set_font(display::BaseFont *font) { this->font_ = font; }
+
+  void play(Ts... x) override {
+    this->parent_->start_scroll(this->text_.value(x...), this->font_, this->y_.value(x...), this->speed_.value(x...),
+                                this->repeat_.value(x...));
+  }
+
+ protected:
+  display::BaseFont *font_{nullptr};
+};
+
+template<typename... Ts> class ScrollStopAction : public Action<Ts...>, public Parented<MAX3000> {
+ public:
+  void play(Ts... x) override { this->parent_->stop_scroll(); }
+};
+
+template<typename... Ts> class ScrollSetAction : public Action<Ts...>, public Parented<MAX3000> {
+ public:
+  TEMPLATABLE_VALUE(float, speed)
+  TEMPLATABLE_VALUE(bool, repeat)
+
+  void play(Ts... x) override {
+    if (this->speed_.has_value()) {
+      this->parent_->set_scroll_speed(this->speed_.value(x...));
+    }
+    if (this->repeat_.has_value()) {
+      this->parent_->set_scroll_repeat(this->repeat_.value(x...));
+    }
+  }
+};
+
 }  // namespace max3000
 }  // namespace esphome
\ No newline at end of file